@@ -0,0 +1,20 @@
+#include "arena.h"
+
+namespace {
+    // larger blocks go to the heap each time
+    constexpr size_t POOL_MAX_BLOCK = size_t{1} << 20;
+}
+
+Arena::Arena()
+    : resource_(buffer_, BUFFER_SIZE, LocalPool())
+{
+}
+
+std::pmr::memory_resource* Arena::Resource() {
+    return &resource_;
+}
+
+std::pmr::memory_resource* Arena::LocalPool() {
+    thread_local std::pmr::unsynchronized_pool_resource pool(std::pmr::pool_options{0, POOL_MAX_BLOCK});
+    return &pool;
+}
@@ -0,0 +1,28 @@
+#pragma once
+
+#include <cstddef>
+#include <memory_resource>
+
+// Scratch memory of one operation. Temporaries are bumped out of a buffer inside the arena and then
+// out of chunks of the thread's pool, and all of it goes back at once when the arena is destroyed,
+// so a warmed up thread takes nothing from the heap for them. Nothing allocated from an arena may
+// outlive it: results that are kept, like Poly coefficients, stay on the heap.
+class Arena {
+public:
+    Arena();
+
+    Arena(const Arena& other) = delete;
+    Arena& operator=(const Arena& other) = delete;
+
+    std::pmr::memory_resource* Resource();
+
+    // pool of the calling thread for scratch that is freed piece by piece, like in a recursion,
+    // where an arena would keep every level's temporaries until the end
+    static std::pmr::memory_resource* LocalPool();
+
+private:
+    static constexpr size_t BUFFER_SIZE = 4096;
+
+    alignas(std::max_align_t) std::byte buffer_[BUFFER_SIZE];
+    std::pmr::monotonic_buffer_resource resource_;
+};
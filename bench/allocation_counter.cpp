@@ -0,0 +1,96 @@
+#include "allocation_counter.h"
+
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+#include <malloc.h>
+
+namespace {
+    std::atomic<size_t> allocations = 0;
+    std::atomic<size_t> live_bytes = 0;
+
+    void* Counted(void* block) {
+        allocations.fetch_add(1, std::memory_order_relaxed);
+        live_bytes.fetch_add(malloc_usable_size(block), std::memory_order_relaxed);
+        return block;
+    }
+
+    void Free(void* block) {
+        if (block) {
+            live_bytes.fetch_sub(malloc_usable_size(block), std::memory_order_relaxed);
+            std::free(block);
+        }
+    }
+
+    void* Allocate(size_t size) {
+        if (void* result = std::malloc(size == 0 ? 1 : size)) {
+            return Counted(result);
+        }
+        throw std::bad_alloc();
+    }
+
+    void* AllocateAligned(size_t size, std::align_val_t alignment) {
+        auto align = static_cast<size_t>(alignment);
+        if (void* result = std::aligned_alloc(align, (size + align - 1) / align * align)) {
+            return Counted(result);
+        }
+        throw std::bad_alloc();
+    }
+}
+
+size_t AllocationCount() {
+    return allocations.load(std::memory_order_relaxed);
+}
+
+size_t LiveBytes() {
+    return live_bytes.load(std::memory_order_relaxed);
+}
+
+void* operator new(size_t size) {
+    return Allocate(size);
+}
+
+void* operator new[](size_t size) {
+    return Allocate(size);
+}
+
+void* operator new(size_t size, std::align_val_t alignment) {
+    return AllocateAligned(size, alignment);
+}
+
+void* operator new[](size_t size, std::align_val_t alignment) {
+    return AllocateAligned(size, alignment);
+}
+
+void operator delete(void* pointer) noexcept {
+    Free(pointer);
+}
+
+void operator delete[](void* pointer) noexcept {
+    Free(pointer);
+}
+
+void operator delete(void* pointer, size_t) noexcept {
+    Free(pointer);
+}
+
+void operator delete[](void* pointer, size_t) noexcept {
+    Free(pointer);
+}
+
+void operator delete(void* pointer, std::align_val_t) noexcept {
+    Free(pointer);
+}
+
+void operator delete[](void* pointer, std::align_val_t) noexcept {
+    Free(pointer);
+}
+
+void operator delete(void* pointer, size_t, std::align_val_t) noexcept {
+    Free(pointer);
+}
+
+void operator delete[](void* pointer, size_t, std::align_val_t) noexcept {
+    Free(pointer);
+}
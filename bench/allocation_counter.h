@@ -0,0 +1,9 @@
+#pragma once
+
+#include <cstddef>
+
+// Linking allocation_counter.cpp replaces the global operator new and delete of the program
+// by counting ones, the count includes every thread.
+size_t AllocationCount();
+// bytes of the blocks allocated and not freed yet, as malloc rounds them
+size_t LiveBytes();
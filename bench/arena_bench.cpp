@@ -0,0 +1,81 @@
+// Scratch memory benchmark, heap calls and time per iteration, one thread. The first part grows a term
+// buffer and an index heap like a sparse product does, with and without an Arena under them. The second
+// part times the sparse Poly operations that take their temporaries from an Arena, for the first call
+// on a cold thread pool and then on average, where the heap calls left are the ones of the results.
+
+#include "allocation_counter.h"
+#include "arena.h"
+#include "poly.h"
+#include "thread_pool.h"
+
+#include <chrono>
+#include <cstdio>
+#include <memory_resource>
+#include <random>
+#include <vector>
+
+namespace {
+    constexpr size_t SCRATCH_TERMS = 256;
+    constexpr size_t POLY_TERMS = 40;
+    constexpr uint64_t MAX_EXPONENT = 1000000;
+    constexpr int ITERATIONS = 2000;
+
+    using Term = std::pair<uint64_t, Fraction>;
+
+    int64_t Scratch(std::pmr::memory_resource* resource) {
+        std::pmr::vector<Term> terms(resource);
+        std::pmr::vector<size_t> heap(resource);
+        for (size_t i = 0; i < SCRATCH_TERMS; ++i) {
+            terms.emplace_back(i, Fraction(static_cast<int64_t>(i)));
+            heap.push_back(SCRATCH_TERMS - i);
+        }
+        return static_cast<int64_t>(terms.size() + heap.back());
+    }
+
+    Poly RandomSparse(std::mt19937& rng) {
+        std::vector<Term> terms;
+        for (size_t i = 0; i < POLY_TERMS; ++i) {
+            terms.emplace_back(i * (MAX_EXPONENT / POLY_TERMS) + rng() % (MAX_EXPONENT / POLY_TERMS),
+                               Fraction(static_cast<int64_t>(rng() % 2001) - 1000));
+        }
+        return Poly(std::move(terms));
+    }
+
+    template <class Operation>
+    void Report(const char* name, Operation operation) {
+        int64_t sink = 0;
+        size_t allocations = AllocationCount();
+        auto start = std::chrono::steady_clock::now();
+        sink += operation();
+        std::chrono::duration<double, std::micro> first = std::chrono::steady_clock::now() - start;
+        size_t first_allocations = AllocationCount() - allocations;
+
+        allocations = AllocationCount();
+        start = std::chrono::steady_clock::now();
+        for (int i = 0; i < ITERATIONS; ++i) {
+            sink += operation();
+        }
+        std::chrono::duration<double, std::micro> elapsed = std::chrono::steady_clock::now() - start;
+        // the sink keeps the operations from being optimized out
+        std::printf("%-22s first %5zu calls %8.1f us, then %7.2f calls %8.2f us (%lld)\n", name, first_allocations,
+                    first.count(), static_cast<double>(AllocationCount() - allocations) / ITERATIONS,
+                    elapsed.count() / ITERATIONS, static_cast<long long>(sink));
+    }
+}
+
+int main() {
+    ThreadPool::SetThreadCount(1);
+    Report("scratch on the heap", [] { return Scratch(std::pmr::new_delete_resource()); });
+    Report("scratch in an arena", [] { Arena arena; return Scratch(arena.Resource()); });
+
+    std::mt19937 rng(1);
+    const auto p = RandomSparse(rng);
+    const auto q = RandomSparse(rng);
+    const auto r = RandomSparse(rng);
+    const auto product = p * q + r;
+    Report("sparse p * q", [&] { return static_cast<int64_t>((p * q).Degree()); });
+    Report("sparse p + q", [&] { return static_cast<int64_t>((p + q).Degree()); });
+    Report("sparse (p * q + r) / q", [&] {
+        return static_cast<int64_t>(DivideWithRemainder(product, q).second.Degree());
+    });
+}
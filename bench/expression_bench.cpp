@@ -0,0 +1,97 @@
+// Element-wise Matrix expressions: heap allocations and time of the lazy one-pass evaluation against
+// the eager evaluation with an intermediate matrix per operation. 500x500 random linear polys, one thread.
+
+#include "allocation_counter.h"
+#include "matrix.h"
+#include "thread_pool.h"
+
+#include <chrono>
+#include <cstdio>
+#include <random>
+
+namespace {
+    constexpr size_t SIZE = 500;
+
+    Matrix<Poly> RandomMatrix(std::mt19937& rng) {
+        Matrix<Poly> result(SIZE);
+        for (size_t i = 0; i < SIZE; ++i) {
+            for (size_t j = 0; j < SIZE; ++j) {
+                result(i, j) = Poly{Fraction(static_cast<int64_t>(rng() % 201) - 100),
+                                    Fraction(static_cast<int64_t>(rng() % 201) - 100)};
+            }
+        }
+        return result;
+    }
+
+    struct Cost {
+        size_t allocations;
+        double milliseconds;
+    };
+
+    template <class Operation>
+    Cost Measure(Operation operation) {
+        size_t allocations = AllocationCount();
+        auto start = std::chrono::steady_clock::now();
+        operation();
+        std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+        return {AllocationCount() - allocations, elapsed.count()};
+    }
+
+    template <class Eager, class Lazy>
+    void Compare(const char* name, Eager eager, Lazy lazy) {
+        Matrix<Poly> eager_result;
+        Matrix<Poly> lazy_result;
+        auto before = Measure([&] { eager_result = eager(); });
+        auto after = Measure([&] { lazy_result = lazy(); });
+        bool same = true;
+        for (size_t i = 0; i < SIZE; ++i) {
+            for (size_t j = 0; j < SIZE; ++j) {
+                same = same && eager_result(i, j) == lazy_result(i, j);
+            }
+        }
+        std::printf("%-18s %9zu -> %9zu allocations, %7.1f -> %7.1f ms%s\n", name, before.allocations,
+                    after.allocations, before.milliseconds, after.milliseconds, same ? "" : " MISMATCH");
+    }
+
+    // eager A - B negates a copy of B and adds it to a copy of A
+    Matrix<Poly> EagerDifference(const Matrix<Poly>& lhs, const Matrix<Poly>& rhs) {
+        Matrix<Poly> negated = rhs;
+        negated *= Poly{Fraction(-1)};
+        Matrix<Poly> result = lhs;
+        result += negated;
+        return result;
+    }
+
+    Matrix<Poly> EagerScale(const Matrix<Poly>& matrix, const Poly& coef) {
+        Matrix<Poly> result = matrix;
+        result *= coef;
+        return result;
+    }
+
+    Matrix<Poly> EagerSum(const Matrix<Poly>& lhs, const Matrix<Poly>& rhs) {
+        Matrix<Poly> result = lhs;
+        result += rhs;
+        return result;
+    }
+}
+
+int main() {
+    ThreadPool::SetThreadCount(1);
+    std::mt19937 rng(1);
+    const auto a = RandomMatrix(rng);
+    const auto b = RandomMatrix(rng);
+    const Poly c{Fraction(3), Fraction(-2)};
+
+    Compare("C = A - B",
+        [&] { return EagerDifference(a, b); },
+        [&] { return Matrix<Poly>(a - b); });
+    Compare("C = A + B * c",
+        [&] { return EagerSum(a, EagerScale(b, c)); },
+        [&] { return Matrix<Poly>(a + b * c); });
+    Compare("C = A - B + A * c",
+        [&] { return EagerSum(EagerDifference(a, b), EagerScale(a, c)); },
+        [&] { return Matrix<Poly>(a - b + a * c); });
+    Compare("A -= B",
+        [&] { Matrix<Poly> result = a; result += EagerScale(b, Poly{Fraction(-1)}); return result; },
+        [&] { Matrix<Poly> result = a; result -= b; return result; });
+}
@@ -0,0 +1,54 @@
+// Small-value Fraction microbenchmark: ns per operation on random num/den in [-1000, 1000] / [1, 1000],
+// the inline int64 fast path that most matrix elements take. Best of PASSES timed passes.
+
+#include "fraction.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <random>
+#include <vector>
+
+namespace {
+    constexpr size_t COUNT = 4096;
+    constexpr int PASSES = 10;
+    constexpr int ROUNDS_PER_PASS = 200;
+
+    template <class Operation>
+    void Bench(const char* name, Operation operation) {
+        int64_t sink = 0;
+        double best = 1e9;
+        for (int pass = 0; pass < PASSES; ++pass) {
+            auto start = std::chrono::steady_clock::now();
+            for (int round = 0; round < ROUNDS_PER_PASS; ++round) {
+                for (size_t i = 0; i < COUNT; ++i) {
+                    sink += operation(i);
+                }
+            }
+            std::chrono::duration<double, std::nano> elapsed = std::chrono::steady_clock::now() - start;
+            best = std::min(best, elapsed.count() / (ROUNDS_PER_PASS * COUNT));
+        }
+        // the sink keeps the operations from being optimized out
+        std::printf("%-8s %6.2f ns/op (%lld)\n", name, best, static_cast<long long>(sink));
+    }
+}
+
+int main() {
+    std::mt19937 rng(1);
+    std::vector<Fraction> a;
+    std::vector<Fraction> b;
+    std::vector<Fraction> r(COUNT);
+    for (size_t i = 0; i < COUNT; ++i) {
+        a.emplace_back(static_cast<int64_t>(rng() % 2001) - 1000, static_cast<int64_t>(rng() % 1000) + 1);
+        b.emplace_back(static_cast<int64_t>(rng() % 1000) + 1, static_cast<int64_t>(rng() % 1000) + 1);
+    }
+
+    Bench("add", [&] (size_t i) { r[i] = a[i] + b[i]; return r[i].Denominator(); });
+    Bench("sub", [&] (size_t i) { r[i] = a[i]; r[i] -= b[i]; return r[i].Denominator(); });
+    Bench("mul", [&] (size_t i) { r[i] = a[i] * b[i]; return r[i].Denominator(); });
+    Bench("div", [&] (size_t i) { r[i] = a[i] / b[i]; return r[i].Denominator(); });
+    Bench("less", [&] (size_t i) { return static_cast<int64_t>(a[i] < b[i]); });
+    Bench("equal", [&] (size_t i) { return static_cast<int64_t>(a[i] == b[(i + 1) % COUNT]); });
+    Bench("fma", [&] (size_t i) { r[i] = a[i]; r[i] += a[i] * b[i]; return r[i].Denominator(); });
+    Bench("copy", [&] (size_t i) { r[i] = a[i]; return r[i].Denominator(); });
+}
@@ -0,0 +1,137 @@
+// Chained expressions with temporary left operands: heap calls and time when every step binds its
+// operand to a const reference, which takes the copying overloads, against the plain chain, which
+// reuses the temporaries. Big fractions of 60 digits, dense polys of degree 40, 120x120 fraction
+// matrices, one thread.
+
+#include "allocation_counter.h"
+#include "matrix.h"
+#include "thread_pool.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace {
+    constexpr size_t DIGITS = 60;
+    constexpr size_t POLY_DEGREE = 40;
+    constexpr size_t MATRIX_SIZE = 120;
+
+    std::string RandomDigits(std::mt19937& rng) {
+        std::string result(1, static_cast<char>('1' + rng() % 9));
+        while (result.size() < DIGITS) {
+            result += static_cast<char>('0' + rng() % 10);
+        }
+        return result;
+    }
+
+    Fraction RandomBig(std::mt19937& rng) {
+        return Fraction(RandomDigits(rng) + "/" + RandomDigits(rng));
+    }
+
+    Poly RandomPoly(std::mt19937& rng) {
+        std::vector<std::pair<uint64_t, Fraction>> terms;
+        for (uint64_t i = 0; i <= POLY_DEGREE; ++i) {
+            terms.emplace_back(i, Fraction(static_cast<int64_t>(rng() % 2000) + 1, static_cast<int64_t>(rng() % 9) + 1));
+        }
+        return Poly(std::move(terms));
+    }
+
+    Matrix<Fraction> RandomMatrix(std::mt19937& rng) {
+        Matrix<Fraction> result(MATRIX_SIZE);
+        for (size_t i = 0; i < MATRIX_SIZE; ++i) {
+            for (size_t j = 0; j < MATRIX_SIZE; ++j) {
+                result(i, j) = Fraction(static_cast<int64_t>(rng() % 201) - 100, static_cast<int64_t>(rng() % 9) + 1);
+            }
+        }
+        return result;
+    }
+
+    bool operator==(const Matrix<Fraction>& lhs, const Matrix<Fraction>& rhs) {
+        auto lhs_data = lhs.Data();
+        auto rhs_data = rhs.Data();
+        return std::equal(lhs_data.begin(), lhs_data.end(), rhs_data.begin(), rhs_data.end());
+    }
+
+    struct Cost {
+        size_t allocations;
+        double milliseconds;
+    };
+
+    template <class Operation>
+    Cost Measure(int iterations, Operation operation) {
+        size_t allocations = AllocationCount();
+        auto start = std::chrono::steady_clock::now();
+        for (int i = 0; i < iterations; ++i) {
+            operation();
+        }
+        std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+        return {AllocationCount() - allocations, elapsed.count()};
+    }
+
+    template <class Copying, class Chained>
+    void Compare(const char* name, int iterations, Copying copying, Chained chained) {
+        bool same = copying() == chained();
+        auto before = Measure(iterations, copying);
+        auto after = Measure(iterations, chained);
+        std::printf("%-34s %9zu -> %9zu calls, %7.1f -> %7.1f ms%s\n", name, before.allocations,
+                    after.allocations, before.milliseconds, after.milliseconds, same ? "" : " MISMATCH");
+    }
+}
+
+int main() {
+    ThreadPool::SetThreadCount(1);
+    std::mt19937 rng(1);
+
+    const auto a = RandomBig(rng);
+    const auto b = RandomBig(rng);
+    const auto c = RandomBig(rng);
+    const auto d = RandomBig(rng);
+    const auto e = RandomBig(rng);
+    Compare("Fraction a * b + c * d - e", 20000,
+        [&] {
+            const Fraction& ab = a * b;
+            const Fraction& cd = c * d;
+            const Fraction& sum = ab + cd;
+            return sum - e;
+        },
+        [&] { return a * b + c * d - e; });
+    Compare("Fraction -(a - b)", 20000,
+        [&] {
+            const Fraction& difference = a - b;
+            return -difference;
+        },
+        [&] { return -(a - b); });
+
+    const auto p = RandomPoly(rng);
+    const auto q = RandomPoly(rng);
+    const auto r = RandomPoly(rng);
+    const auto s = RandomPoly(rng);
+    Compare("Poly p * q + r - s", 200,
+        [&] {
+            const Poly& pq = p * q;
+            const Poly& sum = pq + r;
+            return sum - s;
+        },
+        [&] { return p * q + r - s; });
+    Compare("Poly (p * q - r * q) / q", 200,
+        [&] {
+            const Poly& pq = p * q;
+            const Poly& rq = r * q;
+            const Poly& difference = pq - rq;
+            return difference / q;
+        },
+        [&] { return (p * q - r * q) / q; });
+
+    const auto x = RandomMatrix(rng);
+    const auto y = RandomMatrix(rng);
+    const auto z = RandomMatrix(rng);
+    Compare("Matrix<Fraction> x * y + z - x", 3,
+        [&] {
+            const Matrix<Fraction>& product = x * y;
+            return Matrix<Fraction>(product + z - x);
+        },
+        [&] { return Matrix<Fraction>(x * y + z - x); });
+}
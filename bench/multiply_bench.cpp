@@ -0,0 +1,84 @@
+// Matrix product benchmark: the textbook i-j-k loop with a Poly temporary per term against the tiled
+// i-k-j kernel of operator*, on one thread with Strassen turned off. Entries are random integer polys
+// of degree 0. Sizes are given as arguments, 64 256 1024 by default, the textbook loop is skipped past
+// TEXTBOOK_MAX_SIZE.
+
+#include "matrix.h"
+#include "thread_pool.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <limits>
+#include <random>
+#include <vector>
+
+namespace {
+    constexpr size_t TEXTBOOK_MAX_SIZE = 256;
+
+    Matrix<Poly> RandomMatrix(size_t size, std::mt19937& rng) {
+        Matrix<Poly> result(size);
+        for (size_t i = 0; i < size; ++i) {
+            for (size_t j = 0; j < size; ++j) {
+                result(i, j) = Poly{Fraction(static_cast<int64_t>(rng() % 201) - 100)};
+            }
+        }
+        return result;
+    }
+
+    Matrix<Poly> Textbook(const Matrix<Poly>& lhs, const Matrix<Poly>& rhs) {
+        Matrix<Poly> result(lhs.Rows(), rhs.Columns());
+        for (size_t i = 0; i < lhs.Rows(); ++i) {
+            for (size_t j = 0; j < rhs.Columns(); ++j) {
+                for (size_t k = 0; k < lhs.Columns(); ++k) {
+                    Poly term = lhs(i, k);
+                    term *= rhs(k, j);
+                    result(i, j) += term;
+                }
+            }
+        }
+        return result;
+    }
+
+    template <class Operation>
+    double Seconds(Operation operation) {
+        auto start = std::chrono::steady_clock::now();
+        operation();
+        std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+        return elapsed.count();
+    }
+}
+
+int main(int argc, char** argv) {
+    std::vector<size_t> sizes;
+    for (int i = 1; i < argc; ++i) {
+        sizes.push_back(std::strtoull(argv[i], nullptr, 10));
+    }
+    if (sizes.empty()) {
+        sizes = {64, 256, 1024};
+    }
+    ThreadPool::SetThreadCount(1);
+    SetStrassenCrossover(std::numeric_limits<size_t>::max());
+
+    std::mt19937 rng(1);
+    std::printf("%6s %12s %12s\n", "size", "textbook, s", "tiled, s");
+    for (size_t size : sizes) {
+        auto lhs = RandomMatrix(size, rng);
+        auto rhs = RandomMatrix(size, rng);
+        Matrix<Poly> tiled;
+        double tiled_seconds = Seconds([&] { tiled = lhs * rhs; });
+        if (size > TEXTBOOK_MAX_SIZE) {
+            std::printf("%6zu %12s %12.3f\n", size, "-", tiled_seconds);
+            continue;
+        }
+        Matrix<Poly> textbook;
+        double textbook_seconds = Seconds([&] { textbook = Textbook(lhs, rhs); });
+        bool same = true;
+        for (size_t i = 0; i < size; ++i) {
+            for (size_t j = 0; j < size; ++j) {
+                same = same && textbook(i, j) == tiled(i, j);
+            }
+        }
+        std::printf("%6zu %12.3f %12.3f%s\n", size, textbook_seconds, tiled_seconds, same ? "" : " MISMATCH");
+    }
+}
@@ -0,0 +1,90 @@
+// Dense Poly product benchmark: schoolbook over the coefficients against Poly::operator*, which takes
+// Karatsuba or the multi-prime NTT by length. Random integer coefficients in [-1000, 1000], one thread,
+// best of PASSES. Degrees are given as arguments, 8 to 100000 by default, schoolbook is skipped past
+// SCHOOLBOOK_MAX_DEGREE.
+
+#include "poly.h"
+#include "thread_pool.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <vector>
+
+namespace {
+    constexpr int PASSES = 3;
+    constexpr size_t SCHOOLBOOK_MAX_DEGREE = 5120;
+
+    std::vector<Fraction> RandomCoefficients(size_t degree, std::mt19937& rng) {
+        std::vector<Fraction> result;
+        for (size_t i = 0; i <= degree; ++i) {
+            result.emplace_back(static_cast<int64_t>(rng() % 2001) - 1000);
+        }
+        result.back() = Fraction(1);
+        return result;
+    }
+
+    Poly ToPoly(const std::vector<Fraction>& coefficients) {
+        std::vector<std::pair<uint64_t, Fraction>> terms;
+        for (size_t i = 0; i < coefficients.size(); ++i) {
+            if (coefficients[i] != Fraction(0)) {
+                terms.emplace_back(i, coefficients[i]);
+            }
+        }
+        return Poly(std::move(terms));
+    }
+
+    std::vector<Fraction> Schoolbook(const std::vector<Fraction>& lhs, const std::vector<Fraction>& rhs) {
+        std::vector<Fraction> result(lhs.size() + rhs.size() - 1);
+        for (size_t i = 0; i < lhs.size(); ++i) {
+            for (size_t j = 0; j < rhs.size(); ++j) {
+                result[i + j] += lhs[i] * rhs[j];
+            }
+        }
+        return result;
+    }
+
+    template <class Operation>
+    double BestMilliseconds(Operation operation) {
+        double best = 1e18;
+        for (int pass = 0; pass < PASSES; ++pass) {
+            auto start = std::chrono::steady_clock::now();
+            operation();
+            std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+            best = std::min(best, elapsed.count());
+        }
+        return best;
+    }
+}
+
+int main(int argc, char** argv) {
+    std::vector<size_t> degrees;
+    for (int i = 1; i < argc; ++i) {
+        degrees.push_back(std::strtoull(argv[i], nullptr, 10));
+    }
+    if (degrees.empty()) {
+        degrees = {8, 32, 64, 128, 512, 1024, 5120, 25600, 100000};
+    }
+    ThreadPool::SetThreadCount(1);
+
+    std::mt19937 rng(1);
+    std::printf("%7s %16s %12s\n", "degree", "schoolbook, ms", "Poly *, ms");
+    for (size_t degree : degrees) {
+        auto lhs = RandomCoefficients(degree, rng);
+        auto rhs = RandomCoefficients(degree, rng);
+        auto lhs_poly = ToPoly(lhs);
+        auto rhs_poly = ToPoly(rhs);
+        Poly product;
+        double fast = BestMilliseconds([&] { product = lhs_poly * rhs_poly; });
+        if (degree > SCHOOLBOOK_MAX_DEGREE) {
+            std::printf("%7zu %16s %12.3f\n", degree, "-", fast);
+            continue;
+        }
+        std::vector<Fraction> expected;
+        double schoolbook = BestMilliseconds([&] { expected = Schoolbook(lhs, rhs); });
+        bool same = product == ToPoly(expected);
+        std::printf("%7zu %16.3f %12.3f%s\n", degree, schoolbook, fast, same ? "" : " MISMATCH");
+    }
+}
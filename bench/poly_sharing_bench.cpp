@@ -0,0 +1,103 @@
+// Memory of a 1000x1000 symbolic matrix with plain and interned Poly cells. About 60% of the cells
+// are 0, 1, x or -x and the rest are 13 polys of degree 2 to 100. Heap is counted beyond the cell
+// array itself, for the parsed matrix, for one copy of it and for negating the copy, one thread.
+
+#include "allocation_counter.h"
+#include "matrix.h"
+#include "thread_pool.h"
+
+#include <chrono>
+#include <cstdio>
+#include <random>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace {
+    constexpr size_t SIZE = 1000;
+    constexpr size_t LONG_POLYS = 13;
+
+    std::string RandomPoly(size_t degree, std::mt19937& rng) {
+        std::string result;
+        for (size_t i = degree + 1; i-- > 0;) {
+            int64_t coefficient = static_cast<int64_t>(rng() % 201) - 100;
+            if (coefficient == 0 && i != degree) {
+                continue;
+            }
+            if (coefficient == 0) {
+                coefficient = 1;
+            }
+            if (coefficient > 0 && !result.empty()) {
+                result += '+';
+            }
+            result += std::to_string(coefficient);
+            if (i > 0) {
+                result += "x^" + std::to_string(i);
+            }
+        }
+        return result;
+    }
+
+    std::vector<std::string> RandomCells(std::mt19937& rng) {
+        std::vector<std::string> kinds = {"0", "1", "x", "-x"};
+        for (size_t i = 0; i < LONG_POLYS; ++i) {
+            kinds.push_back(RandomPoly(2 + i * 98 / (LONG_POLYS - 1), rng));
+        }
+        std::vector<std::string> result;
+        for (size_t i = 0; i < SIZE * SIZE; ++i) {
+            result.push_back(rng() % 10 < 6 ? kinds[rng() % 4] : kinds[4 + rng() % LONG_POLYS]);
+        }
+        return result;
+    }
+
+    template <class Operation>
+    void Report(const char* name, Operation operation) {
+        size_t bytes = LiveBytes();
+        size_t allocations = AllocationCount();
+        auto start = std::chrono::steady_clock::now();
+        operation();
+        std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+        std::printf("  %-6s %8.1f MB, %8zu allocations, %7.1f ms\n", name,
+                    (static_cast<double>(LiveBytes()) - static_cast<double>(bytes)) / (1 << 20),
+                    AllocationCount() - allocations, elapsed.count());
+    }
+
+    template <class Parse>
+    void Measure(const char* name, const std::vector<std::string>& cells, Parse parse) {
+        std::printf("%s, heap beyond the %.1f MB cell arrays:\n", name,
+                    static_cast<double>(SIZE * SIZE * sizeof(Poly)) / (1 << 20));
+        // the cell arrays are allocated before the counting starts
+        Matrix<Poly> matrix(SIZE);
+        Matrix<Poly> copy(SIZE);
+        Report("parse", [&] {
+            for (size_t i = 0; i < SIZE; ++i) {
+                for (size_t j = 0; j < SIZE; ++j) {
+                    matrix(i, j) = parse(cells[i * SIZE + j]);
+                }
+            }
+        });
+        Report("copy", [&] {
+            for (size_t i = 0; i < SIZE; ++i) {
+                for (size_t j = 0; j < SIZE; ++j) {
+                    copy(i, j) = matrix(i, j);
+                }
+            }
+        });
+        // negation in place makes every shared cell of the copy take its own storage
+        Report("negate", [&] {
+            for (size_t i = 0; i < SIZE; ++i) {
+                for (size_t j = 0; j < SIZE; ++j) {
+                    copy(i, j) = -std::move(copy(i, j));
+                }
+            }
+        });
+    }
+}
+
+int main() {
+    ThreadPool::SetThreadCount(1);
+    std::mt19937 rng(1);
+    auto cells = RandomCells(rng);
+    Measure("plain Poly(str)", cells, [] (const std::string& cell) { return Poly(cell); });
+    Measure("interned ParseScalar<Poly>", cells, [] (const std::string& cell) { return ParseScalar<Poly>(cell); });
+}
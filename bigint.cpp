@@ -0,0 +1,606 @@
+#include "bigint.h"
+
+#include <algorithm>
+#include <bit>
+#include <charconv>
+#include <cmath>
+#include <numeric>
+#include <span>
+#include <stdexcept>
+
+namespace {
+    using Limbs = std::vector<uint64_t>;
+    using uint128 = unsigned __int128;
+    using int128 = __int128;
+
+    // operands at least that long are multiplied by Karatsuba
+    constexpr size_t KARATSUBA_MIN_LIMBS = 32;
+    // the largest power of ten in a limb
+    constexpr uint64_t DECIMAL_BASE = 10000000000000000000ull;
+    constexpr size_t DECIMAL_DIGITS = 19;
+
+    void Trim(Limbs& limbs) {
+        while (!limbs.empty() && limbs.back() == 0) {
+            limbs.pop_back();
+        }
+    }
+
+    int Compare(std::span<const uint64_t> lhs, std::span<const uint64_t> rhs) {
+        if (lhs.size() != rhs.size()) {
+            return lhs.size() < rhs.size() ? -1 : 1;
+        }
+        for (size_t i = lhs.size(); i-- > 0;) {
+            if (lhs[i] != rhs[i]) {
+                return lhs[i] < rhs[i] ? -1 : 1;
+            }
+        }
+        return 0;
+    }
+
+    // lhs += rhs * 2^(64 * shift)
+    void AddTo(Limbs& lhs, std::span<const uint64_t> rhs, size_t shift = 0) {
+        if (lhs.size() < rhs.size() + shift) {
+            lhs.resize(rhs.size() + shift, 0);
+        }
+        uint64_t carry = 0;
+        size_t i = 0;
+        for (; i < rhs.size(); ++i) {
+            uint128 sum = static_cast<uint128>(lhs[i + shift]) + rhs[i] + carry;
+            lhs[i + shift] = static_cast<uint64_t>(sum);
+            carry = static_cast<uint64_t>(sum >> 64);
+        }
+        for (i += shift; carry != 0; ++i) {
+            if (i == lhs.size()) {
+                lhs.push_back(0);
+            }
+            carry = ++lhs[i] == 0;
+        }
+    }
+
+    // lhs -= rhs * 2^(64 * shift), lhs must not be less
+    void SubtractFrom(Limbs& lhs, std::span<const uint64_t> rhs, size_t shift = 0) {
+        uint64_t borrow = 0;
+        size_t i = 0;
+        for (; i < rhs.size(); ++i) {
+            uint64_t value = lhs[i + shift];
+            uint64_t difference = value - rhs[i];
+            uint64_t next_borrow = value < rhs[i];
+            next_borrow |= difference < borrow;
+            lhs[i + shift] = difference - borrow;
+            borrow = next_borrow;
+        }
+        for (i += shift; borrow != 0; ++i) {
+            borrow = lhs[i]-- == 0;
+        }
+        Trim(lhs);
+    }
+
+    // limbs = limbs * factor + addend
+    void MultiplyAddLimb(Limbs& limbs, uint64_t factor, uint64_t addend) {
+        uint64_t carry = addend;
+        for (auto& limb : limbs) {
+            uint128 product = static_cast<uint128>(limb) * factor + carry;
+            limb = static_cast<uint64_t>(product);
+            carry = static_cast<uint64_t>(product >> 64);
+        }
+        if (carry != 0) {
+            limbs.push_back(carry);
+        }
+        Trim(limbs);
+    }
+
+    // limbs /= divisor, returns the remainder
+    uint64_t DivideByLimb(Limbs& limbs, uint64_t divisor) {
+        uint64_t remainder = 0;
+        for (size_t i = limbs.size(); i-- > 0;) {
+            uint128 current = (static_cast<uint128>(remainder) << 64) | limbs[i];
+            limbs[i] = static_cast<uint64_t>(current / divisor);
+            remainder = static_cast<uint64_t>(current % divisor);
+        }
+        Trim(limbs);
+        return remainder;
+    }
+
+    // result has lhs.size() + rhs.size() zero limbs
+    void MultiplySchoolbook(std::span<const uint64_t> lhs, std::span<const uint64_t> rhs, Limbs& result) {
+        for (size_t i = 0; i < lhs.size(); ++i) {
+            uint64_t carry = 0;
+            for (size_t j = 0; j < rhs.size(); ++j) {
+                uint128 current = static_cast<uint128>(lhs[i]) * rhs[j] + result[i + j] + carry;
+                result[i + j] = static_cast<uint64_t>(current);
+                carry = static_cast<uint64_t>(current >> 64);
+            }
+            result[i + rhs.size()] = carry;
+        }
+    }
+
+    std::span<const uint64_t> Trimmed(std::span<const uint64_t> limbs) {
+        while (!limbs.empty() && limbs.back() == 0) {
+            limbs = limbs.first(limbs.size() - 1);
+        }
+        return limbs;
+    }
+
+    Limbs Multiply(std::span<const uint64_t> lhs, std::span<const uint64_t> rhs) {
+        lhs = Trimmed(lhs);
+        rhs = Trimmed(rhs);
+        if (lhs.empty() || rhs.empty()) {
+            return {};
+        }
+        if (lhs.size() < rhs.size()) {
+            std::swap(lhs, rhs);
+        }
+
+        Limbs result;
+        if (rhs.size() < KARATSUBA_MIN_LIMBS) {
+            result.assign(lhs.size() + rhs.size(), 0);
+            MultiplySchoolbook(lhs, rhs, result);
+        } else if (lhs.size() >= 2 * rhs.size()) {
+            // the longer operand is cut into pieces as long as the shorter one
+            for (size_t offset = 0; offset < lhs.size(); offset += rhs.size()) {
+                auto piece = lhs.subspan(offset, std::min(rhs.size(), lhs.size() - offset));
+                AddTo(result, Multiply(piece, rhs), offset);
+            }
+        } else {
+            // (l1 B + l0)(r1 B + r0) = l1 r1 B^2 + ((l1 + l0)(r1 + r0) - l1 r1 - l0 r0) B + l0 r0
+            size_t half = (lhs.size() + 1) / 2;
+            auto lhs_low = lhs.first(half);
+            auto lhs_high = lhs.subspan(half);
+            auto rhs_low = rhs.first(std::min(half, rhs.size()));
+            auto rhs_high = rhs.subspan(rhs_low.size());
+
+            Limbs low = Multiply(lhs_low, rhs_low);
+            Limbs high = Multiply(lhs_high, rhs_high);
+            Limbs lhs_sum(lhs_low.begin(), lhs_low.end());
+            Limbs rhs_sum(rhs_low.begin(), rhs_low.end());
+            AddTo(lhs_sum, lhs_high);
+            AddTo(rhs_sum, rhs_high);
+            Limbs middle = Multiply(lhs_sum, rhs_sum);
+            SubtractFrom(middle, low);
+            SubtractFrom(middle, high);
+
+            result = std::move(low);
+            AddTo(result, middle, half);
+            AddTo(result, high, 2 * half);
+        }
+        Trim(result);
+        return result;
+    }
+
+    // lhs * 2^shift with size limbs, shift < 64
+    Limbs ShiftLeft(const Limbs& limbs, int shift, size_t size) {
+        Limbs result(size, 0);
+        for (size_t i = 0; i < limbs.size(); ++i) {
+            result[i] |= limbs[i] << shift;
+            if (shift != 0 && i + 1 < size) {
+                result[i + 1] |= limbs[i] >> (64 - shift);
+            }
+        }
+        return result;
+    }
+
+    void ShiftRight(Limbs& limbs, int shift) {
+        if (shift != 0) {
+            for (size_t i = 0; i < limbs.size(); ++i) {
+                limbs[i] >>= shift;
+                if (i + 1 < limbs.size()) {
+                    limbs[i] |= limbs[i + 1] << (64 - shift);
+                }
+            }
+        }
+        Trim(limbs);
+    }
+
+    // Knuth's algorithm D, rhs is not zero
+    std::pair<Limbs, Limbs> DivideMagnitudes(const Limbs& lhs, const Limbs& rhs) {
+        if (Compare(lhs, rhs) < 0) {
+            return {Limbs{}, lhs};
+        }
+        if (rhs.size() == 1) {
+            Limbs quotient = lhs;
+            uint64_t remainder = DivideByLimb(quotient, rhs[0]);
+            return {std::move(quotient), remainder == 0 ? Limbs{} : Limbs{remainder}};
+        }
+
+        // the divisor is shifted to have its top bit set, so that the quotient digit estimates are off by at most 2
+        int shift = std::countl_zero(rhs.back());
+        Limbs dividend = ShiftLeft(lhs, shift, lhs.size() + 1);
+        Limbs divisor = ShiftLeft(rhs, shift, rhs.size());
+        size_t n = divisor.size();
+        size_t m = lhs.size() - n;
+        Limbs quotient(m + 1, 0);
+        for (size_t j = m + 1; j-- > 0;) {
+            uint128 top = (static_cast<uint128>(dividend[j + n]) << 64) | dividend[j + n - 1];
+            uint128 digit = top / divisor[n - 1];
+            uint128 rest = top % divisor[n - 1];
+            while ((digit >> 64) != 0 || digit * divisor[n - 2] > ((rest << 64) | dividend[j + n - 2])) {
+                --digit;
+                rest += divisor[n - 1];
+                if ((rest >> 64) != 0) {
+                    break;
+                }
+            }
+
+            uint64_t carry = 0;
+            uint64_t borrow = 0;
+            for (size_t i = 0; i < n; ++i) {
+                uint128 product = digit * divisor[i] + carry;
+                carry = static_cast<uint64_t>(product >> 64);
+                uint64_t low = static_cast<uint64_t>(product);
+                uint64_t value = dividend[i + j];
+                uint64_t difference = value - low;
+                uint64_t next_borrow = value < low;
+                next_borrow |= difference < borrow;
+                dividend[i + j] = difference - borrow;
+                borrow = next_borrow;
+            }
+            uint64_t value = dividend[j + n];
+            uint64_t difference = value - carry;
+            bool negative = value < carry || difference < borrow;
+            dividend[j + n] = difference - borrow;
+
+            if (negative) {
+                --digit;
+                uint64_t add_carry = 0;
+                for (size_t i = 0; i < n; ++i) {
+                    uint128 sum = static_cast<uint128>(dividend[i + j]) + divisor[i] + add_carry;
+                    dividend[i + j] = static_cast<uint64_t>(sum);
+                    add_carry = static_cast<uint64_t>(sum >> 64);
+                }
+                dividend[j + n] += add_carry;
+            }
+            quotient[j] = static_cast<uint64_t>(digit);
+        }
+        Trim(quotient);
+        dividend.resize(n);
+        ShiftRight(dividend, shift);
+        return {std::move(quotient), std::move(dividend)};
+    }
+
+    // 64 bits of limbs starting from the bit offset
+    uint64_t BitsAt(const Limbs& limbs, size_t offset) {
+        size_t index = offset / 64;
+        int shift = offset % 64;
+        uint64_t result = limbs[index] >> shift;
+        if (shift != 0 && index + 1 < limbs.size()) {
+            result |= limbs[index + 1] << (64 - shift);
+        }
+        return result;
+    }
+
+    Limbs MultiplyByLimb(const Limbs& limbs, uint64_t factor) {
+        Limbs result = limbs;
+        MultiplyAddLimb(result, factor, 0);
+        return result;
+    }
+
+    // lhs_factor * lhs + rhs_factor * rhs for factors of different signs and a non-negative result
+    Limbs Combine(const Limbs& lhs, int128 lhs_factor, const Limbs& rhs, int128 rhs_factor) {
+        Limbs lhs_product = MultiplyByLimb(lhs, static_cast<uint64_t>(lhs_factor < 0 ? -lhs_factor : lhs_factor));
+        Limbs rhs_product = MultiplyByLimb(rhs, static_cast<uint64_t>(rhs_factor < 0 ? -rhs_factor : rhs_factor));
+        if ((lhs_factor < 0) == (rhs_factor < 0)) {
+            AddTo(lhs_product, rhs_product);
+            return lhs_product;
+        }
+        if (lhs_factor < 0) {
+            SubtractFrom(rhs_product, lhs_product);
+            return rhs_product;
+        }
+        SubtractFrom(lhs_product, rhs_product);
+        return lhs_product;
+    }
+}
+
+BigInt::BigInt(int64_t value)
+    : negative_(value < 0)
+{
+    if (value != 0) {
+        limbs_.push_back(value < 0 ? 0 - static_cast<uint64_t>(value) : static_cast<uint64_t>(value));
+    }
+}
+
+BigInt::BigInt(std::string_view str) {
+    bool negative = !str.empty() && str[0] == '-';
+    std::string_view digits = str.substr(!str.empty() && (str[0] == '-' || str[0] == '+') ? 1 : 0);
+    if (digits.empty() || digits.find_first_not_of("0123456789") != std::string_view::npos) {
+        throw std::invalid_argument("can't parse integer " + std::string(str));
+    }
+    size_t chunk = digits.size() % DECIMAL_DIGITS;
+    if (chunk == 0) {
+        chunk = DECIMAL_DIGITS;
+    }
+    for (size_t begin = 0; begin < digits.size(); begin += chunk, chunk = DECIMAL_DIGITS) {
+        uint64_t value = 0;
+        std::from_chars(digits.data() + begin, digits.data() + begin + chunk, value);
+        uint64_t scale = 1;
+        for (size_t i = 0; i < chunk; ++i) {
+            scale *= 10;
+        }
+        MultiplyAddLimb(limbs_, scale, value);
+    }
+    negative_ = negative;
+    Trim();
+}
+
+BigInt BigInt::FromInt128(int128 value) {
+    uint128 magnitude = value < 0 ? -static_cast<uint128>(value) : static_cast<uint128>(value);
+    BigInt result;
+    result.limbs_ = {static_cast<uint64_t>(magnitude), static_cast<uint64_t>(magnitude >> 64)};
+    result.negative_ = value < 0;
+    result.Trim();
+    return result;
+}
+
+BigInt BigInt::FromMagnitude(std::span<const uint64_t> limbs, bool negative) {
+    BigInt result;
+    result.limbs_.assign(limbs.begin(), limbs.end());
+    result.negative_ = negative;
+    result.Trim();
+    return result;
+}
+
+void BigInt::Trim() {
+    ::Trim(limbs_);
+    if (limbs_.empty()) {
+        negative_ = false;
+    }
+}
+
+BigInt BigInt::operator-() const& {
+    return -BigInt(*this);
+}
+
+BigInt BigInt::operator-() && {
+    negative_ = !negative_ && !limbs_.empty();
+    return std::move(*this);
+}
+
+BigInt& BigInt::operator+=(const BigInt& other) {
+    if (negative_ == other.negative_) {
+        AddTo(limbs_, other.limbs_);
+    } else if (Compare(limbs_, other.limbs_) >= 0) {
+        SubtractFrom(limbs_, other.limbs_);
+    } else {
+        Limbs result = other.limbs_;
+        SubtractFrom(result, limbs_);
+        limbs_ = std::move(result);
+        negative_ = other.negative_;
+    }
+    Trim();
+    return *this;
+}
+
+// a - b = -(-a + b), without a negated copy of other
+BigInt& BigInt::operator-=(const BigInt& other) {
+    if (this == &other) {
+        return *this = BigInt();
+    }
+    negative_ = !negative_;
+    *this += other;
+    negative_ = !negative_ && !limbs_.empty();
+    return *this;
+}
+
+BigInt& BigInt::operator*=(const BigInt& other) {
+    limbs_ = Multiply(limbs_, other.limbs_);
+    negative_ = negative_ != other.negative_;
+    Trim();
+    return *this;
+}
+
+BigInt& BigInt::operator/=(const BigInt& other) {
+    return *this = DivideWithRemainder(*this, other).first;
+}
+
+BigInt& BigInt::operator%=(const BigInt& other) {
+    return *this = DivideWithRemainder(*this, other).second;
+}
+
+std::strong_ordering BigInt::operator<=>(const BigInt& other) const {
+    if (negative_ != other.negative_) {
+        return negative_ ? std::strong_ordering::less : std::strong_ordering::greater;
+    }
+    int result = Compare(limbs_, other.limbs_);
+    return (negative_ ? -result : result) <=> 0;
+}
+
+bool BigInt::IsZero() const {
+    return limbs_.empty();
+}
+
+bool BigInt::IsNegative() const {
+    return negative_;
+}
+
+bool BigInt::FitsInt64() const {
+    if (limbs_.size() > 1) {
+        return false;
+    }
+    uint64_t limit = static_cast<uint64_t>(INT64_MAX) + (negative_ ? 1 : 0);
+    return limbs_.empty() || limbs_[0] <= limit;
+}
+
+int64_t BigInt::ToInt64() const {
+    if (limbs_.empty()) {
+        return 0;
+    }
+    return static_cast<int64_t>(negative_ ? 0 - limbs_[0] : limbs_[0]);
+}
+
+uint32_t BigInt::Residue(uint32_t mod) const {
+    uint64_t result = 0;
+    for (size_t i = limbs_.size(); i-- > 0;) {
+        result = static_cast<uint64_t>(((static_cast<uint128>(result) << 64) | limbs_[i]) % mod);
+    }
+    return static_cast<uint32_t>(negative_ && result != 0 ? mod - result : result);
+}
+
+std::pair<double, int64_t> BigInt::Frexp() const {
+    if (limbs_.empty()) {
+        return {0.0, 0};
+    }
+    size_t size = limbs_.size();
+    double top = static_cast<double>(limbs_[size - 1]);
+    int64_t shift = 0;
+    if (size > 1) {
+        top = std::ldexp(top, 64) + static_cast<double>(limbs_[size - 2]);
+        shift = 64 * static_cast<int64_t>(size - 2);
+    }
+    int exponent = 0;
+    double mantissa = std::frexp(top, &exponent);
+    return {negative_ ? -mantissa : mantissa, exponent + shift};
+}
+
+std::span<const uint64_t> BigInt::Magnitude() const {
+    return limbs_;
+}
+
+std::string BigInt::AsString() const {
+    if (limbs_.empty()) {
+        return "0";
+    }
+    Limbs rest = limbs_;
+    std::vector<uint64_t> chunks;
+    while (!rest.empty()) {
+        chunks.push_back(DivideByLimb(rest, DECIMAL_BASE));
+    }
+    std::string result = negative_ ? "-" : "";
+    result += std::to_string(chunks.back());
+    for (size_t i = chunks.size() - 1; i-- > 0;) {
+        std::string chunk = std::to_string(chunks[i]);
+        result.append(DECIMAL_DIGITS - chunk.size(), '0');
+        result += chunk;
+    }
+    return result;
+}
+
+BigInt operator+(const BigInt& lhs, const BigInt& rhs) {
+    BigInt result = lhs;
+    result += rhs;
+    return result;
+}
+
+BigInt operator-(const BigInt& lhs, const BigInt& rhs) {
+    BigInt result = lhs;
+    result -= rhs;
+    return result;
+}
+
+BigInt operator*(const BigInt& lhs, const BigInt& rhs) {
+    BigInt result = lhs;
+    result *= rhs;
+    return result;
+}
+
+BigInt operator/(const BigInt& lhs, const BigInt& rhs) {
+    BigInt result = lhs;
+    result /= rhs;
+    return result;
+}
+
+BigInt operator%(const BigInt& lhs, const BigInt& rhs) {
+    BigInt result = lhs;
+    result %= rhs;
+    return result;
+}
+
+BigInt operator+(BigInt&& lhs, const BigInt& rhs) {
+    lhs += rhs;
+    return std::move(lhs);
+}
+
+BigInt operator-(BigInt&& lhs, const BigInt& rhs) {
+    lhs -= rhs;
+    return std::move(lhs);
+}
+
+BigInt operator*(BigInt&& lhs, const BigInt& rhs) {
+    lhs *= rhs;
+    return std::move(lhs);
+}
+
+BigInt operator/(BigInt&& lhs, const BigInt& rhs) {
+    lhs /= rhs;
+    return std::move(lhs);
+}
+
+BigInt operator%(BigInt&& lhs, const BigInt& rhs) {
+    lhs %= rhs;
+    return std::move(lhs);
+}
+
+std::pair<BigInt, BigInt> DivideWithRemainder(const BigInt& lhs, const BigInt& rhs) {
+    if (rhs.IsZero()) {
+        throw std::domain_error("integer division by zero");
+    }
+    auto [quotient_limbs, remainder_limbs] = DivideMagnitudes(lhs.limbs_, rhs.limbs_);
+    BigInt quotient;
+    quotient.limbs_ = std::move(quotient_limbs);
+    quotient.negative_ = lhs.negative_ != rhs.negative_;
+    quotient.Trim();
+    BigInt remainder;
+    remainder.limbs_ = std::move(remainder_limbs);
+    remainder.negative_ = lhs.negative_;
+    remainder.Trim();
+    return {std::move(quotient), std::move(remainder)};
+}
+
+// Lehmer: while both numbers are long, Euclid's steps are run on their leading 63 bits, as long
+// as the quotients are sure to be the same as for the whole numbers, and then applied at once
+BigInt Gcd(BigInt lhs, BigInt rhs) {
+    Limbs a = std::move(lhs.limbs_);
+    Limbs b = std::move(rhs.limbs_);
+    if (Compare(a, b) < 0) {
+        std::swap(a, b);
+    }
+    while (b.size() > 1) {
+        if (a.size() != b.size()) {
+            a = DivideMagnitudes(a, b).second;
+            std::swap(a, b);
+            continue;
+        }
+
+        size_t offset = 64 * a.size() - std::countl_zero(a.back()) - 63;
+        int128 x = BitsAt(a, offset);
+        int128 y = BitsAt(b, offset);
+        int128 A = 1;
+        int128 B = 0;
+        int128 C = 0;
+        int128 D = 1;
+        while (y + C != 0 && y + D != 0) {
+            int128 q = (x + A) / (y + C);
+            if (q != (x + B) / (y + D)) {
+                break;
+            }
+            int128 t = A - q * C;
+            A = C;
+            C = t;
+            t = B - q * D;
+            B = D;
+            D = t;
+            t = x - q * y;
+            x = y;
+            y = t;
+        }
+
+        if (B == 0) {
+            a = DivideMagnitudes(a, b).second;
+            std::swap(a, b);
+        } else {
+            Limbs next_a = Combine(a, A, b, B);
+            Limbs next_b = Combine(a, C, b, D);
+            a = std::move(next_a);
+            b = std::move(next_b);
+        }
+    }
+
+    BigInt result;
+    if (b.empty()) {
+        result.limbs_ = std::move(a);
+    } else {
+        uint64_t remainder = DivideByLimb(a, b[0]);
+        result.limbs_ = {std::gcd(b[0], remainder)};
+    }
+    result.Trim();
+    return result;
+}
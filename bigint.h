@@ -0,0 +1,78 @@
+#pragma once
+
+#include <compare>
+#include <cstdint>
+#include <span>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+// Arbitrary precision integer: sign and magnitude in 64-bit limbs, the least significant first.
+// Long products go through Karatsuba, Gcd is Lehmer's over 63-bit leading digits.
+class BigInt {
+public:
+    BigInt() = default;
+    BigInt(int64_t value);
+    // "[+|-]digits"
+    explicit BigInt(std::string_view str);
+
+    static BigInt FromInt128(__int128 value);
+    // limbs of the absolute value, the least significant first, may have leading zeros
+    static BigInt FromMagnitude(std::span<const uint64_t> limbs, bool negative);
+
+    BigInt operator-() const&;
+    // negates in place and keeps the limbs
+    BigInt operator-() &&;
+    BigInt& operator+=(const BigInt& other);
+    BigInt& operator-=(const BigInt& other);
+    BigInt& operator*=(const BigInt& other);
+    // truncating like the built-in integers
+    BigInt& operator/=(const BigInt& other);
+    BigInt& operator%=(const BigInt& other);
+
+    bool operator==(const BigInt& other) const = default;
+    std::strong_ordering operator<=>(const BigInt& other) const;
+
+    bool IsZero() const;
+    bool IsNegative() const;
+    bool FitsInt64() const;
+    // only for values that fit
+    int64_t ToInt64() const;
+    // the value modulo mod in [0, mod)
+    uint32_t Residue(uint32_t mod) const;
+    // value = mantissa * 2^exponent with 0.5 <= |mantissa| < 1, doesn't overflow like a plain double
+    std::pair<double, int64_t> Frexp() const;
+    // limbs of the absolute value without leading zeros
+    std::span<const uint64_t> Magnitude() const;
+
+    std::string AsString() const;
+
+    friend std::pair<BigInt, BigInt> DivideWithRemainder(const BigInt& lhs, const BigInt& rhs);
+    friend BigInt Gcd(BigInt lhs, BigInt rhs);
+
+private:
+    void Trim();
+
+private:
+    std::vector<uint64_t> limbs_;
+    bool negative_ = false;
+};
+
+BigInt operator+(const BigInt& lhs, const BigInt& rhs);
+BigInt operator-(const BigInt& lhs, const BigInt& rhs);
+BigInt operator*(const BigInt& lhs, const BigInt& rhs);
+BigInt operator/(const BigInt& lhs, const BigInt& rhs);
+BigInt operator%(const BigInt& lhs, const BigInt& rhs);
+
+// a temporary lhs is updated and returned instead of being copied, sums keep its limbs
+BigInt operator+(BigInt&& lhs, const BigInt& rhs);
+BigInt operator-(BigInt&& lhs, const BigInt& rhs);
+BigInt operator*(BigInt&& lhs, const BigInt& rhs);
+BigInt operator/(BigInt&& lhs, const BigInt& rhs);
+BigInt operator%(BigInt&& lhs, const BigInt& rhs);
+
+// truncated quotient and the remainder with the sign of lhs, throws on zero divisor
+std::pair<BigInt, BigInt> DivideWithRemainder(const BigInt& lhs, const BigInt& rhs);
+// non-negative, Gcd(0, 0) = 0
+BigInt Gcd(BigInt lhs, BigInt rhs);
@@ -0,0 +1,168 @@
+#include "charpoly.h"
+
+#include "modular.h"
+
+#include <algorithm>
+#include <utility>
+#include <vector>
+
+namespace {
+    // smaller integer matrices go straight to Berkowitz, it is cheaper than a few primes
+    constexpr size_t MODULAR_MIN_SIZE = 16;
+    // exact Hessenberg reduction of fractions swells its entries, so primes pay off at a smaller size
+    constexpr size_t FRACTION_MODULAR_MIN_SIZE = 8;
+
+    // coefficients by growing exponent
+    Poly ToPoly(std::vector<Fraction> coefficients) {
+        std::vector<std::pair<uint64_t, Fraction>> terms;
+        for (uint64_t i = 0; i < coefficients.size(); ++i) {
+            if (!IsZero(coefficients[i])) {
+                terms.emplace_back(i, std::move(coefficients[i]));
+            }
+        }
+        return Poly(std::move(terms));
+    }
+
+    CheckedInt Dot(std::span<const CheckedInt> lhs, const std::vector<CheckedInt>& rhs) {
+        CheckedInt result = 0;
+        for (size_t i = 0; i < rhs.size(); ++i) {
+            result += lhs[i] * rhs[i];
+        }
+        return result;
+    }
+
+    // The leading (r + 1) x (r + 1) block is [M S; R a]. Its polynomial is the Toeplitz matrix
+    // of the column 1, -a, -RS, -RMS, ..., -RM^{r-1}S times the polynomial of M.
+    // Coefficients are by decreasing exponent.
+    std::vector<CheckedInt> Berkowitz(const Matrix<CheckedInt>& matrix) {
+        size_t N = matrix.Rows();
+        std::vector<CheckedInt> result = {1};
+        std::vector<CheckedInt> toeplitz, column, next;
+        for (size_t r = 0; r < N; ++r) {
+            toeplitz.assign(r + 2, 0);
+            toeplitz[0] = 1;
+            toeplitz[1] = -matrix(r, r);
+            column.resize(r);
+            for (size_t i = 0; i < r; ++i) {
+                column[i] = matrix(i, r);
+            }
+            auto row = matrix.Row(r).first(r);
+            for (size_t k = 2; k < r + 2; ++k) {
+                toeplitz[k] = -Dot(row, column);
+                if (k + 1 < r + 2) {
+                    next.resize(r);
+                    for (size_t i = 0; i < r; ++i) {
+                        next[i] = Dot(matrix.Row(i).first(r), column);
+                    }
+                    column.swap(next);
+                }
+            }
+
+            next.assign(r + 2, 0);
+            for (size_t i = 0; i < r + 2; ++i) {
+                for (size_t j = 0; j <= std::min(i, r); ++j) {
+                    next[i] += toeplitz[i - j] * result[j];
+                }
+            }
+            result.swap(next);
+        }
+        return result;
+    }
+
+    // Gaussian elimination below the subdiagonal, every row operation is paired with the
+    // inverse column one, so the eigenvalues are kept
+    void ReduceToHessenberg(Matrix<Fraction>& matrix) {
+        size_t N = matrix.Rows();
+        for (size_t j = 0; j + 2 < N; ++j) {
+            size_t pivot = j + 1;
+            while (pivot < N && IsZero(matrix(pivot, j))) {
+                ++pivot;
+            }
+            if (pivot == N) {
+                continue;
+            }
+            if (pivot != j + 1) {
+                matrix.SwapRows(pivot, j + 1);
+                for (size_t i = 0; i < N; ++i) {
+                    std::swap(matrix(i, pivot), matrix(i, j + 1));
+                }
+            }
+
+            Fraction inverse = Fraction(1) / matrix(j + 1, j);
+            for (size_t i = j + 2; i < N; ++i) {
+                if (IsZero(matrix(i, j))) {
+                    continue;
+                }
+                Fraction factor = matrix(i, j) * inverse;
+                for (size_t k = j; k < N; ++k) {
+                    matrix(i, k) -= factor * matrix(j + 1, k);
+                }
+                for (size_t k = 0; k < N; ++k) {
+                    matrix(k, j + 1) += factor * matrix(k, i);
+                }
+            }
+        }
+    }
+
+    // p_{k+1} = (x - h_kk) p_k - sum_i h_ik h_{i+1,i} ... h_{k,k-1} p_i, coefficients by growing exponent
+    std::vector<Fraction> Hessenberg(Matrix<Fraction> matrix) {
+        ReduceToHessenberg(matrix);
+        size_t N = matrix.Rows();
+        std::vector<std::vector<Fraction>> polys(N + 1);
+        polys[0] = {1};
+        for (size_t k = 0; k < N; ++k) {
+            const auto& previous = polys[k];
+            auto& current = polys[k + 1];
+            current.assign(k + 2, 0);
+            for (size_t d = 0; d <= k; ++d) {
+                current[d + 1] += previous[d];
+                current[d] -= matrix(k, k) * previous[d];
+            }
+
+            Fraction product = 1;
+            for (size_t i = k; i-- > 0;) {
+                product *= matrix(i + 1, i);
+                if (IsZero(product)) {
+                    break;
+                }
+                if (IsZero(matrix(i, k))) {
+                    continue;
+                }
+                Fraction factor = matrix(i, k) * product;
+                for (size_t d = 0; d <= i; ++d) {
+                    current[d] -= factor * polys[i][d];
+                }
+            }
+        }
+        return std::move(polys[N]);
+    }
+}
+
+template <Scalar T>
+    requires std::same_as<T, CheckedInt> || std::same_as<T, Fraction>
+Poly CharacteristicPolynomial(const Matrix<T>& matrix) {
+    if (!matrix.IsSquare() || matrix.Rows() == 0) {
+        throw MatrixException("Try to find characteristic polynomial of non square matrix");
+    }
+
+    // the modular answer is taken only past the bound on the minors or after several random primes agree
+    if (matrix.Rows() >= (std::is_same_v<T, Fraction> ? FRACTION_MODULAR_MIN_SIZE : MODULAR_MIN_SIZE)) {
+        if (auto result = ModularCharacteristicPolynomial(matrix)) {
+            return *result;
+        }
+    }
+    if constexpr (std::is_same_v<T, CheckedInt>) {
+        auto descending = Berkowitz(matrix);
+        std::vector<Fraction> coefficients;
+        coefficients.reserve(descending.size());
+        for (auto it = descending.rbegin(); it != descending.rend(); ++it) {
+            coefficients.emplace_back(it->Value());
+        }
+        return ToPoly(std::move(coefficients));
+    } else {
+        return ToPoly(Hessenberg(matrix));
+    }
+}
+
+template Poly CharacteristicPolynomial(const Matrix<CheckedInt>& matrix);
+template Poly CharacteristicPolynomial(const Matrix<Fraction>& matrix);
@@ -0,0 +1,10 @@
+#pragma once
+
+#include "matrix.h"
+
+// det(xI - A) of a square numeric matrix. Integers go through division-free Berkowitz,
+// O(n^4), so every intermediate value stays an integer. Fractions are first reduced to
+// upper Hessenberg form by similarity, then the polynomial is unrolled in O(n^3).
+template <Scalar T>
+    requires std::same_as<T, CheckedInt> || std::same_as<T, Fraction>
+Poly CharacteristicPolynomial(const Matrix<T>& matrix);
@@ -0,0 +1,18 @@
+#include "checked_int.h"
+
+#include <charconv>
+
+CheckedInt::CheckedInt(std::string_view str) {
+    const char* end = str.data() + str.size();
+    auto [ptr, error] = std::from_chars(str.data() + (str.starts_with('+') ? 1 : 0), end, value_);
+    if (error == std::errc::result_out_of_range) {
+        throw std::overflow_error("integer overflow");
+    }
+    if (error != std::errc{} || ptr != end) {
+        throw std::invalid_argument("can't parse integer " + std::string(str));
+    }
+}
+
+std::string CheckedInt::AsString() const {
+    return std::to_string(value_);
+}
@@ -0,0 +1,102 @@
+#pragma once
+
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+
+// int64_t that throws instead of wrapping around on overflow
+class CheckedInt {
+public:
+    CheckedInt() = default;
+    CheckedInt(int64_t value);
+    explicit CheckedInt(std::string_view str);
+
+    CheckedInt operator-() const;
+    CheckedInt& operator+=(const CheckedInt& other);
+    CheckedInt& operator-=(const CheckedInt& other);
+    CheckedInt& operator*=(const CheckedInt& other);
+    CheckedInt& operator/=(const CheckedInt& other);
+
+    bool operator==(const CheckedInt& other) const = default;
+    auto operator<=>(const CheckedInt& other) const = default;
+
+    int64_t Value() const;
+    std::string AsString() const;
+
+private:
+    int64_t value_ = 0;
+};
+
+CheckedInt operator+(const CheckedInt& lhs, const CheckedInt& rhs);
+CheckedInt operator-(const CheckedInt& lhs, const CheckedInt& rhs);
+CheckedInt operator*(const CheckedInt& lhs, const CheckedInt& rhs);
+CheckedInt operator/(const CheckedInt& lhs, const CheckedInt& rhs);
+
+inline CheckedInt::CheckedInt(int64_t value)
+    : value_(value)
+{}
+
+inline CheckedInt CheckedInt::operator-() const {
+    return CheckedInt{} -= *this;
+}
+
+inline CheckedInt& CheckedInt::operator+=(const CheckedInt& other) {
+    if (__builtin_add_overflow(value_, other.value_, &value_)) {
+        throw std::overflow_error("integer overflow");
+    }
+    return *this;
+}
+
+inline CheckedInt& CheckedInt::operator-=(const CheckedInt& other) {
+    if (__builtin_sub_overflow(value_, other.value_, &value_)) {
+        throw std::overflow_error("integer overflow");
+    }
+    return *this;
+}
+
+inline CheckedInt& CheckedInt::operator*=(const CheckedInt& other) {
+    if (__builtin_mul_overflow(value_, other.value_, &value_)) {
+        throw std::overflow_error("integer overflow");
+    }
+    return *this;
+}
+
+inline CheckedInt& CheckedInt::operator/=(const CheckedInt& other) {
+    if (other.value_ == 0) {
+        throw std::domain_error("integer division by zero");
+    }
+    if (other.value_ == -1) {
+        return *this = -*this;
+    }
+    value_ /= other.value_;
+    return *this;
+}
+
+inline int64_t CheckedInt::Value() const {
+    return value_;
+}
+
+inline CheckedInt operator+(const CheckedInt& lhs, const CheckedInt& rhs) {
+    CheckedInt result = lhs;
+    result += rhs;
+    return result;
+}
+
+inline CheckedInt operator-(const CheckedInt& lhs, const CheckedInt& rhs) {
+    CheckedInt result = lhs;
+    result -= rhs;
+    return result;
+}
+
+inline CheckedInt operator*(const CheckedInt& lhs, const CheckedInt& rhs) {
+    CheckedInt result = lhs;
+    result *= rhs;
+    return result;
+}
+
+inline CheckedInt operator/(const CheckedInt& lhs, const CheckedInt& rhs) {
+    CheckedInt result = lhs;
+    result /= rhs;
+    return result;
+}
@@ -1,115 +1,229 @@
 #include "fraction.h"
 
+#include <algorithm>
+#include <charconv>
+#include <cmath>
 #include <numeric>
+#include <stdexcept>
+
+namespace {
+    using int128 = __int128;
+    using uint128 = unsigned __int128;
+
+    uint128 Gcd(uint128 lhs, uint128 rhs) {
+        while (rhs > UINT64_MAX) {
+            lhs %= rhs;
+            std::swap(lhs, rhs);
+        }
+        if (rhs == 0) {
+            return lhs;
+        }
+        return std::gcd(static_cast<uint64_t>(lhs % rhs), static_cast<uint64_t>(rhs));
+    }
 
-Fraction::Fraction() : Fraction(0) {}
+    // parses an int64 or, if it's out of range, a BigInt
+    bool ParseInteger(std::string_view str, int64_t& small, BigInt& big, bool& is_big) {
+        const char* end = str.data() + str.size();
+        auto [ptr, error] = std::from_chars(str.data(), end, small);
+        if (error == std::errc::result_out_of_range && ptr == end) {
+            big = BigInt(str);
+            is_big = true;
+            return true;
+        }
+        is_big = false;
+        return error == std::errc{} && ptr == end;
+    }
+}
 
-Fraction::Fraction(int64_t up, int64_t down)
-    : up_(up)
-    , down_(down)
+Fraction::Fraction(BigInt up, BigInt down)
+    : up_(0)
+    , down_(1)
 {
-    if (down_ == 0) {
-        throw std::exception{};
+    if (down.IsZero()) {
+        throw std::domain_error("fraction division by zero");
     }
-    Normalize();
+    Assign(std::move(up), std::move(down));
 }
 
-Fraction::Fraction(int64_t n) : Fraction(n, 1) {}
-
-Fraction Fraction::operator-() const {
-    Fraction copy = *this;
-    copy.up_ *= -1;
-    return copy;
+Fraction::Fraction(std::string_view str)
+    : up_(0)
+    , down_(1)
+{
+    const char* end = str.data() + str.size();
+    const char* slash = std::find(str.data(), end, '/');
+    std::string_view up_str(str.data() + (str.starts_with('+') ? 1 : 0), slash);
+    std::string_view down_str = slash == end ? std::string_view("1") : std::string_view(slash + 1, end);
+
+    int64_t up = 0;
+    int64_t down = 1;
+    BigInt big_up;
+    BigInt big_down;
+    bool up_is_big = false;
+    bool down_is_big = false;
+    bool ok = ParseInteger(up_str, up, big_up, up_is_big) && ParseInteger(down_str, down, big_down, down_is_big);
+    if (!ok || (!down_is_big && down == 0)) {
+        throw std::invalid_argument("can't parse fraction " + std::string(str));
+    }
+    if (up_is_big || down_is_big) {
+        Assign(up_is_big ? std::move(big_up) : BigInt(up), down_is_big ? std::move(big_down) : BigInt(down));
+    } else if (up == INT64_MIN || down == INT64_MIN) {
+        Assign(static_cast<int128>(up), static_cast<int128>(down));
+    } else {
+        Assign(up, down);
+    }
 }
 
-Fraction& Fraction::operator+=(const Fraction& other) {
-    up_ = up_ * other.down_ + other.up_ * down_;
-    down_ *= other.down_;
-    Normalize();
-    return *this;
+void Fraction::SetBig(BigInt up, BigInt down) {
+    if (up.IsZero()) {
+        SetSmall(0, 1);
+    } else if (up.FitsInt64() && down.FitsInt64() && up != BigInt(INT64_MIN) && down != BigInt(INT64_MIN)) {
+        SetSmall(up.ToInt64(), down.ToInt64());
+    } else if (down_ == 0) {
+        big_->up = std::move(up);
+        big_->down = std::move(down);
+    } else {
+        big_ = new Big{std::move(up), std::move(down)};
+        down_ = 0;
+    }
 }
 
-Fraction& Fraction::operator-=(const Fraction& other) {
-    return *this += -other;
+void Fraction::Assign(int128 up, int128 down) {
+    bool negative = (up < 0) != (down < 0);
+    uint128 up_magnitude = up < 0 ? -static_cast<uint128>(up) : static_cast<uint128>(up);
+    uint128 down_magnitude = down < 0 ? -static_cast<uint128>(down) : static_cast<uint128>(down);
+    uint128 gcd = Gcd(up_magnitude, down_magnitude);
+    up_magnitude /= gcd;
+    down_magnitude /= gcd;
+    if (up_magnitude <= INT64_MAX && down_magnitude <= INT64_MAX) {
+        auto small_up = static_cast<int64_t>(up_magnitude);
+        SetSmall(negative ? -small_up : small_up, static_cast<int64_t>(down_magnitude));
+    } else {
+        auto signed_up = static_cast<int128>(up_magnitude);
+        SetBig(BigInt::FromInt128(negative ? -signed_up : signed_up),
+               BigInt::FromInt128(static_cast<int128>(down_magnitude)));
+    }
 }
 
-Fraction& Fraction::operator*=(const Fraction& other) {
-    up_ *= other.up_;
-    down_ *= other.down_;
-    Normalize();
-    return *this;
+void Fraction::Assign(BigInt up, BigInt down) {
+    BigInt gcd = Gcd(up, down);
+    if (down.IsNegative()) {
+        gcd = -gcd;
+    }
+    if (gcd != BigInt(1)) {
+        up /= gcd;
+        down /= gcd;
+    }
+    SetBig(std::move(up), std::move(down));
+}
+
+void Fraction::AddSlow(const Fraction& other, bool negative) {
+    if (down_ != 0 && other.down_ != 0) {
+        int64_t other_up = negative ? -other.up_ : other.up_;
+        Assign(static_cast<int128>(up_) * other.down_ + static_cast<int128>(other_up) * down_,
+               static_cast<int128>(down_) * other.down_);
+    } else {
+        // the same cancellation as in AddSmall
+        BigInt down = BigDenominator();
+        BigInt other_down = other.BigDenominator();
+        BigInt gcd = Gcd(down, other_down);
+        down /= gcd;
+        BigInt other_part = other.BigNumerator() * down;
+        BigInt sum = BigNumerator() * (other_down / gcd);
+        if (negative) {
+            sum -= other_part;
+        } else {
+            sum += other_part;
+        }
+        BigInt rest = Gcd(sum, gcd);
+        SetBig(std::move(sum) / rest, std::move(down) * (other_down / rest));
+    }
 }
 
-Fraction& Fraction::operator/=(const Fraction& other) {
-    up_ *= other.down_;
-    down_ *= other.up_;
-    Normalize();
-    return *this;
+void Fraction::MultiplySlow(const Fraction& other) {
+    if (down_ != 0 && other.down_ != 0) {
+        Assign(static_cast<int128>(up_) * other.up_, static_cast<int128>(down_) * other.down_);
+    } else {
+        BigInt up = BigNumerator();
+        BigInt down = BigDenominator();
+        BigInt other_up = other.BigNumerator();
+        BigInt other_down = other.BigDenominator();
+        BigInt left = Gcd(up, other_down);
+        BigInt right = Gcd(other_up, down);
+        SetBig((up / left) * (other_up / right), (down / right) * (other_down / left));
+    }
 }
 
-void Fraction::Normalize() {
-    auto gcd = std::gcd(up_, down_);
-    up_ /= gcd;
-    down_ /= gcd;
-    if (down_ < 0) {
-        up_ *= -1;
-        down_ *= -1;
+void Fraction::DivideSlow(const Fraction& other) {
+    if (other.IsZero()) {
+        throw std::domain_error("fraction division by zero");
+    }
+    if (down_ != 0 && other.down_ != 0) {
+        Assign(static_cast<int128>(up_) * other.down_, static_cast<int128>(down_) * other.up_);
+    } else {
+        BigInt up = BigNumerator();
+        BigInt down = BigDenominator();
+        BigInt other_up = other.BigNumerator();
+        BigInt other_down = other.BigDenominator();
+        BigInt left = Gcd(up, other_up);
+        BigInt right = Gcd(down, other_down);
+        BigInt result_up = (up / left) * (other_down / right);
+        BigInt result_down = (down / right) * (other_up / left);
+        if (result_down.IsNegative()) {
+            result_up = -result_up;
+            result_down = -result_down;
+        }
+        SetBig(std::move(result_up), std::move(result_down));
     }
 }
 
-
-bool Fraction::operator==(const Fraction& other) const {
-    return up_ == other.up_ && down_ == other.down_;
+bool Fraction::LessSlow(const Fraction& other) const {
+    if (down_ != 0 && other.down_ != 0) {
+        return static_cast<int128>(up_) * other.down_ < static_cast<int128>(other.up_) * down_;
+    }
+    return BigNumerator() * other.BigDenominator() < other.BigNumerator() * BigDenominator();
 }
 
-bool Fraction::operator!=(const Fraction& other) const {
-    return !(*this == other);
+BigInt Fraction::BigNumerator() const {
+    return down_ != 0 ? BigInt(up_) : big_->up;
 }
 
-bool Fraction::operator<(const Fraction& other) const {
-    return up_ * other.down_ < other.up_ * down_;
+BigInt Fraction::BigDenominator() const {
+    return down_ != 0 ? BigInt(down_) : big_->down;
 }
 
-bool Fraction::operator<=(const Fraction& other) const {
-    return !(*this > other);
+uint32_t Fraction::NumeratorResidue(uint32_t mod) const {
+    if (down_ == 0) {
+        return big_->up.Residue(mod);
+    }
+    int64_t result = up_ % static_cast<int64_t>(mod);
+    return static_cast<uint32_t>(result < 0 ? result + mod : result);
 }
 
-bool Fraction::operator>(const Fraction& other) const {
-    return other < *this;
+uint32_t Fraction::DenominatorResidue(uint32_t mod) const {
+    return down_ != 0 ? static_cast<uint32_t>(down_ % mod) : big_->down.Residue(mod);
 }
 
-bool Fraction::operator>=(const Fraction& other) const {
-    return !(*this < other);
+double Fraction::ToDouble() const {
+    if (down_ != 0) {
+        return static_cast<double>(up_) / static_cast<double>(down_);
+    }
+    auto [up_mantissa, up_exponent] = big_->up.Frexp();
+    auto [down_mantissa, down_exponent] = big_->down.Frexp();
+    return std::ldexp(up_mantissa / down_mantissa, static_cast<int>(std::clamp<int64_t>(
+        up_exponent - down_exponent, INT32_MIN, INT32_MAX)));
 }
 
 std::string Fraction::AsString() const {
+    if (down_ == 0) {
+        std::string result = big_->up.AsString();
+        if (big_->down != BigInt(1)) {
+            result += '/' + big_->down.AsString();
+        }
+        return result;
+    }
     std::string result = std::to_string(up_);
     if (down_ != 1) {
         result += '/' + std::to_string(down_);
     }
     return result;
 }
-
-Fraction operator+(const Fraction& lhs, const Fraction& rhs) {
-    Fraction result = lhs;
-    result += rhs;
-    return result;
-}
-
-Fraction operator-(const Fraction& lhs, const Fraction& rhs) {
-    Fraction result = lhs;
-    result -= rhs;
-    return result;
-}
-
-Fraction operator*(const Fraction& lhs, const Fraction& rhs) {
-    Fraction result = lhs;
-    result *= rhs;
-    return result;
-}
-
-Fraction operator/(const Fraction& lhs, const Fraction& rhs) {
-    Fraction result = lhs;
-    result /= rhs;
-    return result;
-}
@@ -1,21 +1,36 @@
 #pragma once
 
+#include "bigint.h"
+
+#include <bit>
 #include <cstdint>
+#include <stdexcept>
 #include <string>
+#include <string_view>
+#include <utility>
 
+// Exact rational number. Values whose numerator and denominator fit into int64 are kept inline
+// and computed with overflow-checked builtins, anything longer moves to a heap BigInt pair.
+// The inline form is used whenever the value fits, so equal values are represented equally.
 class Fraction {
 public:
     Fraction();
     Fraction(int64_t up, int64_t down);
     Fraction(int64_t n);
+    Fraction(BigInt up, BigInt down);
+    // "[-]up[/down]"
+    explicit Fraction(std::string_view str);
 
-    Fraction(const Fraction& other) = default;
-    Fraction(Fraction&& other) = default;
+    Fraction(const Fraction& other);
+    Fraction(Fraction&& other) noexcept;
+    ~Fraction();
 
-    Fraction& operator=(const Fraction& other) = default;
-    Fraction& operator=(Fraction&& other) = default;
+    Fraction& operator=(const Fraction& other);
+    Fraction& operator=(Fraction&& other) noexcept;
 
-    Fraction operator-() const;
+    Fraction operator-() const&;
+    // negates in place and keeps the big form's storage
+    Fraction operator-() &&;
     Fraction& operator+=(const Fraction& other);
     Fraction& operator-=(const Fraction& other);
     Fraction& operator*=(const Fraction& other);
@@ -28,13 +43,54 @@ public:
     bool operator>(const Fraction& other) const;
     bool operator>=(const Fraction& other) const;
 
+    bool IsZero() const;
+    // numerator and denominator fit into int64
+    bool IsSmall() const;
+    // throw std::overflow_error unless IsSmall()
+    int64_t Numerator() const;
+    int64_t Denominator() const;
+    BigInt BigNumerator() const;
+    BigInt BigDenominator() const;
+    // residues in [0, mod)
+    uint32_t NumeratorResidue(uint32_t mod) const;
+    uint32_t DenominatorResidue(uint32_t mod) const;
+    double ToDouble() const;
+
     std::string AsString() const;
 
 private:
-    void Normalize();
+    struct Big {
+        BigInt up;
+        BigInt down;
+    };
+
+    // up != INT64_MIN and 0 < down, already reduced
+    void SetSmall(int64_t up, int64_t down);
+    // reduced with a positive denominator
+    void SetBig(BigInt up, BigInt down);
+    // Stein's binary gcd, shifts and subtractions instead of Euclid's divisions
+    static uint64_t BinaryGcd(uint64_t lhs, uint64_t rhs);
+    static uint64_t Abs(int64_t value);
+
+    // down != 0, up and down != INT64_MIN
+    void Assign(int64_t up, int64_t down);
+    void Assign(__int128 up, __int128 down);
+    void Assign(BigInt up, BigInt down);
+
+    // *this += up / down for a reduced small fraction, false and unchanged if it overflows
+    bool AddSmall(int64_t up, int64_t down);
+    // *this += other or, if negative, *this -= other
+    void AddSlow(const Fraction& other, bool negative);
+    void MultiplySlow(const Fraction& other);
+    void DivideSlow(const Fraction& other);
+    bool LessSlow(const Fraction& other) const;
 
 private:
-    int64_t up_;
+    union {
+        int64_t up_;
+        Big* big_;
+    };
+    // 0 marks the big form
     int64_t down_;
 };
 
@@ -42,3 +98,423 @@ Fraction operator+(const Fraction& lhs, const Fraction& rhs);
 Fraction operator-(const Fraction& lhs, const Fraction& rhs);
 Fraction operator*(const Fraction& lhs, const Fraction& rhs);
 Fraction operator/(const Fraction& lhs, const Fraction& rhs);
+
+// a temporary lhs is updated and returned instead of being copied
+Fraction operator+(Fraction&& lhs, const Fraction& rhs);
+Fraction operator-(Fraction&& lhs, const Fraction& rhs);
+Fraction operator*(Fraction&& lhs, const Fraction& rhs);
+Fraction operator/(Fraction&& lhs, const Fraction& rhs);
+
+// Opt-in sum of products for dot product loops: terms are added to an unreduced int64 fraction,
+// with no gcd at all while they share the denominator, and the sum is reduced once in Result().
+// Whatever doesn't fit spills into an exact Fraction.
+class FractionAccumulator {
+public:
+    // *this += lhs * rhs
+    void AddProduct(const Fraction& lhs, const Fraction& rhs);
+    Fraction Result() const;
+
+private:
+    bool TryAdd(int64_t up, int64_t down);
+
+private:
+    int64_t up_ = 0;
+    int64_t down_ = 1;
+    Fraction rest_;
+};
+
+inline Fraction::Fraction()
+    : up_(0)
+    , down_(1)
+{}
+
+inline Fraction::Fraction(int64_t n)
+    : up_(n)
+    , down_(1)
+{
+    if (n == INT64_MIN) {
+        down_ = 0;
+        big_ = new Big{BigInt(n), BigInt(1)};
+    }
+}
+
+inline Fraction::Fraction(int64_t up, int64_t down)
+    : up_(0)
+    , down_(1)
+{
+    if (down == 0) {
+        throw std::domain_error("fraction division by zero");
+    }
+    if (up == INT64_MIN || down == INT64_MIN) {
+        Assign(static_cast<__int128>(up), static_cast<__int128>(down));
+    } else {
+        Assign(up, down);
+    }
+}
+
+inline Fraction::Fraction(const Fraction& other)
+    : down_(other.down_)
+{
+    if (down_ == 0) {
+        big_ = new Big(*other.big_);
+    } else {
+        up_ = other.up_;
+    }
+}
+
+inline Fraction::Fraction(Fraction&& other) noexcept
+    : down_(other.down_)
+{
+    if (down_ == 0) {
+        big_ = other.big_;
+    } else {
+        up_ = other.up_;
+    }
+    other.up_ = 0;
+    other.down_ = 1;
+}
+
+inline Fraction::~Fraction() {
+    if (down_ == 0) {
+        delete big_;
+    }
+}
+
+inline Fraction& Fraction::operator=(const Fraction& other) {
+    if ((down_ != 0) & (other.down_ != 0)) {
+        up_ = other.up_;
+        down_ = other.down_;
+    } else if (other.down_ != 0) {
+        SetSmall(other.up_, other.down_);
+    } else if (this != &other) {
+        if (down_ == 0) {
+            *big_ = *other.big_;
+        } else {
+            big_ = new Big(*other.big_);
+            down_ = 0;
+        }
+    }
+    return *this;
+}
+
+inline Fraction& Fraction::operator=(Fraction&& other) noexcept {
+    if (this != &other) {
+        if (down_ == 0) {
+            delete big_;
+        }
+        down_ = other.down_;
+        if (down_ == 0) {
+            big_ = other.big_;
+        } else {
+            up_ = other.up_;
+        }
+        other.up_ = 0;
+        other.down_ = 1;
+    }
+    return *this;
+}
+
+inline void Fraction::SetSmall(int64_t up, int64_t down) {
+    if (down_ == 0) {
+        delete big_;
+    }
+    up_ = up;
+    down_ = down;
+}
+
+inline uint64_t Fraction::BinaryGcd(uint64_t lhs, uint64_t rhs) {
+    if (lhs == 0 || rhs == 0) {
+        return lhs | rhs;
+    }
+    // integers and unit numerators are common and would take a subtraction per bit
+    if (lhs == 1 || rhs == 1) {
+        return 1;
+    }
+    int shift = std::countr_zero(lhs | rhs);
+    lhs >>= std::countr_zero(lhs);
+    do {
+        rhs >>= std::countr_zero(rhs);
+        if (lhs > rhs) {
+            std::swap(lhs, rhs);
+        }
+        rhs -= lhs;
+    } while (rhs != 0);
+    return lhs << shift;
+}
+
+inline uint64_t Fraction::Abs(int64_t value) {
+    return value < 0 ? 0 - static_cast<uint64_t>(value) : static_cast<uint64_t>(value);
+}
+
+inline void Fraction::Assign(int64_t up, int64_t down) {
+    auto gcd = static_cast<int64_t>(BinaryGcd(Abs(up), Abs(down)));
+    if (down < 0) {
+        gcd = -gcd;
+    }
+    SetSmall(up / gcd, down / gcd);
+}
+
+// Knuth's addition: with g = gcd(b, d), a/b + c/d = t / (b/g * d) for t = a * d/g + c * b/g,
+// and only gcd(t, g) is left to cancel, so equal or coprime denominators need no reduction of the sum
+inline bool Fraction::AddSmall(int64_t up, int64_t down) {
+    int64_t sum;
+    if (down_ == down) {
+        if (__builtin_add_overflow(up_, up, &sum) || sum == INT64_MIN) {
+            return false;
+        }
+        if (down == 1) {
+            up_ = sum;
+        } else {
+            auto gcd = static_cast<int64_t>(BinaryGcd(Abs(sum), static_cast<uint64_t>(down)));
+            up_ = sum / gcd;
+            down_ = down / gcd;
+        }
+        return true;
+    }
+
+    auto gcd = static_cast<int64_t>(BinaryGcd(static_cast<uint64_t>(down_), static_cast<uint64_t>(down)));
+    int64_t left, right, result_down;
+    if (__builtin_mul_overflow(up_, down / gcd, &left) || __builtin_mul_overflow(up, down_ / gcd, &right)
+        || __builtin_add_overflow(left, right, &sum) || sum == INT64_MIN)
+    {
+        return false;
+    }
+    auto rest = gcd == 1 ? 1 : static_cast<int64_t>(BinaryGcd(Abs(sum), static_cast<uint64_t>(gcd)));
+    if (__builtin_mul_overflow(down_ / gcd, down / rest, &result_down)) {
+        return false;
+    }
+    up_ = sum / rest;
+    down_ = sum == 0 ? 1 : result_down;
+    return true;
+}
+
+inline Fraction& Fraction::operator+=(const Fraction& other) {
+    if (down_ == 0 || other.down_ == 0 || !AddSmall(other.up_, other.down_)) {
+        AddSlow(other, false);
+    }
+    return *this;
+}
+
+inline Fraction Fraction::operator-() const& {
+    if (down_ != 0) {
+        Fraction result;
+        result.up_ = -up_;
+        result.down_ = down_;
+        return result;
+    }
+    return -Fraction(*this);
+}
+
+inline Fraction Fraction::operator-() && {
+    if (down_ != 0) {
+        up_ = -up_;
+    } else {
+        big_->up = -std::move(big_->up);
+    }
+    return std::move(*this);
+}
+
+inline Fraction& Fraction::operator-=(const Fraction& other) {
+    if (down_ == 0 || other.down_ == 0 || !AddSmall(-other.up_, other.down_)) {
+        AddSlow(other, true);
+    }
+    return *this;
+}
+
+// Both fractions are reduced, so cancelling each numerator against the other denominator
+// leaves the product reduced. It takes two gcds instead of one, so it is only done
+// when the plain product doesn't fit.
+inline Fraction& Fraction::operator*=(const Fraction& other) {
+    if (down_ != 0 && other.down_ != 0) {
+        int64_t up, down;
+        if (!__builtin_mul_overflow(up_, other.up_, &up) && !__builtin_mul_overflow(down_, other.down_, &down)
+            && up != INT64_MIN)
+        {
+            Assign(up, down);
+            return *this;
+        }
+        auto left = static_cast<int64_t>(BinaryGcd(Abs(up_), static_cast<uint64_t>(other.down_)));
+        auto right = static_cast<int64_t>(BinaryGcd(Abs(other.up_), static_cast<uint64_t>(down_)));
+        if (!__builtin_mul_overflow(up_ / left, other.up_ / right, &up)
+            && !__builtin_mul_overflow(down_ / right, other.down_ / left, &down) && up != INT64_MIN)
+        {
+            SetSmall(up, down);
+            return *this;
+        }
+    }
+    MultiplySlow(other);
+    return *this;
+}
+
+inline Fraction& Fraction::operator/=(const Fraction& other) {
+    if (down_ != 0 && other.down_ != 0 && other.up_ != 0) {
+        int64_t up, down;
+        if (!__builtin_mul_overflow(up_, other.down_, &up) && !__builtin_mul_overflow(down_, other.up_, &down)
+            && up != INT64_MIN && down != INT64_MIN)
+        {
+            Assign(up, down);
+            return *this;
+        }
+        auto left = static_cast<int64_t>(BinaryGcd(Abs(up_), Abs(other.up_)));
+        auto right = static_cast<int64_t>(BinaryGcd(static_cast<uint64_t>(down_), static_cast<uint64_t>(other.down_)));
+        if (!__builtin_mul_overflow(up_ / left, other.down_ / right, &up)
+            && !__builtin_mul_overflow(down_ / right, other.up_ / left, &down) && up != INT64_MIN
+            && down != INT64_MIN)
+        {
+            SetSmall(down < 0 ? -up : up, down < 0 ? -down : down);
+            return *this;
+        }
+    }
+    DivideSlow(other);
+    return *this;
+}
+
+inline bool Fraction::operator==(const Fraction& other) const {
+    if (down_ != other.down_) {
+        return false;
+    }
+    if (down_ != 0) {
+        return up_ == other.up_;
+    }
+    return big_->up == other.big_->up && big_->down == other.big_->down;
+}
+
+inline bool Fraction::operator!=(const Fraction& other) const {
+    return !(*this == other);
+}
+
+inline bool Fraction::operator<(const Fraction& other) const {
+    if (down_ != 0 && down_ == other.down_) {
+        return up_ < other.up_;
+    }
+    int64_t left, right;
+    if (down_ != 0 && other.down_ != 0
+        && !__builtin_mul_overflow(up_, other.down_, &left) && !__builtin_mul_overflow(other.up_, down_, &right))
+    {
+        return left < right;
+    }
+    return LessSlow(other);
+}
+
+inline bool Fraction::operator<=(const Fraction& other) const {
+    return !(other < *this);
+}
+
+inline bool Fraction::operator>(const Fraction& other) const {
+    return other < *this;
+}
+
+inline bool Fraction::operator>=(const Fraction& other) const {
+    return !(*this < other);
+}
+
+inline int64_t Fraction::Numerator() const {
+    if (down_ == 0) {
+        throw std::overflow_error("integer overflow");
+    }
+    return up_;
+}
+
+inline int64_t Fraction::Denominator() const {
+    if (down_ == 0) {
+        throw std::overflow_error("integer overflow");
+    }
+    return down_;
+}
+
+inline bool Fraction::IsZero() const {
+    return down_ != 0 && up_ == 0;
+}
+
+inline bool Fraction::IsSmall() const {
+    return down_ != 0;
+}
+
+inline Fraction operator+(const Fraction& lhs, const Fraction& rhs) {
+    Fraction result = lhs;
+    result += rhs;
+    return result;
+}
+
+inline Fraction operator-(const Fraction& lhs, const Fraction& rhs) {
+    Fraction result = lhs;
+    result -= rhs;
+    return result;
+}
+
+inline Fraction operator*(const Fraction& lhs, const Fraction& rhs) {
+    Fraction result = lhs;
+    result *= rhs;
+    return result;
+}
+
+inline Fraction operator/(const Fraction& lhs, const Fraction& rhs) {
+    Fraction result = lhs;
+    result /= rhs;
+    return result;
+}
+
+inline Fraction operator+(Fraction&& lhs, const Fraction& rhs) {
+    lhs += rhs;
+    return std::move(lhs);
+}
+
+inline Fraction operator-(Fraction&& lhs, const Fraction& rhs) {
+    lhs -= rhs;
+    return std::move(lhs);
+}
+
+inline Fraction operator*(Fraction&& lhs, const Fraction& rhs) {
+    lhs *= rhs;
+    return std::move(lhs);
+}
+
+inline Fraction operator/(Fraction&& lhs, const Fraction& rhs) {
+    lhs /= rhs;
+    return std::move(lhs);
+}
+
+inline bool FractionAccumulator::TryAdd(int64_t up, int64_t down) {
+    int64_t sum;
+    if (down == down_) {
+        if (__builtin_add_overflow(up_, up, &sum)) {
+            return false;
+        }
+        up_ = sum;
+        return true;
+    }
+    int64_t scaled;
+    if (down_ % down == 0) {
+        if (__builtin_mul_overflow(up, down_ / down, &scaled) || __builtin_add_overflow(up_, scaled, &sum)) {
+            return false;
+        }
+        up_ = sum;
+        return true;
+    }
+    int64_t left, right, result_down;
+    if (__builtin_mul_overflow(up_, down, &left) || __builtin_mul_overflow(up, down_, &right)
+        || __builtin_add_overflow(left, right, &sum) || __builtin_mul_overflow(down_, down, &result_down))
+    {
+        return false;
+    }
+    up_ = sum;
+    down_ = result_down;
+    return true;
+}
+
+inline void FractionAccumulator::AddProduct(const Fraction& lhs, const Fraction& rhs) {
+    int64_t up, down;
+    if (!lhs.IsSmall() || !rhs.IsSmall() || __builtin_mul_overflow(lhs.Numerator(), rhs.Numerator(), &up)
+        || __builtin_mul_overflow(lhs.Denominator(), rhs.Denominator(), &down))
+    {
+        rest_ += lhs * rhs;
+    } else if (!TryAdd(up, down)) {
+        rest_ += Fraction(up_, down_);
+        up_ = up;
+        down_ = down;
+    }
+}
+
+inline Fraction FractionAccumulator::Result() const {
+    return rest_ + Fraction(up_, down_);
+}
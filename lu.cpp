@@ -0,0 +1,139 @@
+#include "lu.h"
+
+#include "thread_pool.h"
+
+#include <algorithm>
+
+namespace {
+    constexpr size_t SOLVE_BLOCK_COLUMNS = 64;
+}
+
+template <Scalar T>
+    requires IS_FIELD<T>
+LUDecomposition<T>::LUDecomposition(const Matrix<T>& matrix)
+    : lu_(matrix)
+{
+    if (!lu_.IsSquare() || lu_.Rows() == 0) {
+        throw MatrixException("Try to factorize non square matrix");
+    }
+
+    size_t N = lu_.Rows();
+    permutation_.resize(N);
+    for (size_t i = 0; i < N; ++i) {
+        permutation_[i] = i;
+    }
+
+    for (size_t line = 0; line < N; ++line) {
+        size_t found = line;
+        if constexpr (IS_APPROXIMATE<T>) {
+            // partial pivoting keeps rounding errors bounded
+            for (size_t i = line + 1; i < N; ++i) {
+                if (std::abs(lu_(i, line)) > std::abs(lu_(found, line))) {
+                    found = i;
+                }
+            }
+            if (IsZero(lu_(found, line))) found = N;
+        } else {
+            while (found < N && IsZero(lu_(found, line))) ++found;
+        }
+        if (found == N) {
+            singular_ = true;
+            return;
+        }
+        if (found != line) {
+            lu_.SwapRows(line, found);
+            std::swap(permutation_[line], permutation_[found]);
+            negative_ = !negative_;
+        }
+
+        auto pivot_row = lu_.Row(line);
+        ThreadPool::Instance().ParallelFor(line + 1, N, [&] (size_t i) {
+            auto row = lu_.Row(i);
+            if (IsZero(row[line])) return;
+            row[line] /= pivot_row[line];
+            const auto& coef = row[line];
+            for (size_t j = line + 1; j < N; ++j) {
+                SubProduct(row[j], pivot_row[j], coef);
+            }
+        }, ThreadPool::Grain(N - line));
+    }
+}
+
+template <Scalar T>
+    requires IS_FIELD<T>
+bool LUDecomposition<T>::IsSingular() const {
+    return singular_;
+}
+
+template <Scalar T>
+    requires IS_FIELD<T>
+T LUDecomposition<T>::Determinant() const {
+    if (singular_) {
+        return T{};
+    }
+    T result = negative_ ? T{-1} : T{1};
+    for (size_t i = 0; i < lu_.Rows(); ++i) {
+        result *= lu_(i, i);
+    }
+    return result;
+}
+
+template <Scalar T>
+    requires IS_FIELD<T>
+Matrix<T> LUDecomposition<T>::Inverted() const {
+    return Solve(Matrix<T>::UnitMatrix(lu_.Rows()));
+}
+
+template <Scalar T>
+    requires IS_FIELD<T>
+Matrix<T> LUDecomposition<T>::Solve(const Matrix<T>& rhs) const {
+    if (singular_) {
+        throw MatrixException("Try to solve with degenerate matrix");
+    }
+    size_t N = lu_.Rows();
+    if (rhs.Rows() != N) {
+        throw MatrixException("Try to solve with right side of wrong size");
+    }
+
+    size_t M = rhs.Columns();
+    Matrix<T> result(N, M);
+    for (size_t i = 0; i < N; ++i) {
+        auto source = rhs.Row(permutation_[i]);
+        std::copy(source.begin(), source.end(), result.Row(i).begin());
+    }
+
+    // columns of the right side are independent, so blocks of them are split between threads
+    size_t column_blocks = (M + SOLVE_BLOCK_COLUMNS - 1) / SOLVE_BLOCK_COLUMNS;
+    ThreadPool::Instance().ParallelFor(0, column_blocks, [&] (size_t column_block) {
+        size_t from = column_block * SOLVE_BLOCK_COLUMNS;
+        size_t to = std::min(from + SOLVE_BLOCK_COLUMNS, M);
+        for (size_t i = 0; i < N; ++i) {
+            auto row = result.Row(i);
+            for (size_t k = 0; k < i; ++k) {
+                if (IsZero(lu_(i, k))) continue;
+                auto other = result.Row(k);
+                for (size_t j = from; j < to; ++j) {
+                    SubProduct(row[j], other[j], lu_(i, k));
+                }
+            }
+        }
+        for (size_t i = N; i-- > 0;) {
+            auto row = result.Row(i);
+            for (size_t k = i + 1; k < N; ++k) {
+                if (IsZero(lu_(i, k))) continue;
+                auto other = result.Row(k);
+                for (size_t j = from; j < to; ++j) {
+                    SubProduct(row[j], other[j], lu_(i, k));
+                }
+            }
+            for (size_t j = from; j < to; ++j) {
+                row[j] /= lu_(i, i);
+            }
+        }
+    });
+    return result;
+}
+
+template class LUDecomposition<Fraction>;
+template class LUDecomposition<double>;
+template class LUDecomposition<Poly>;
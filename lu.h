@@ -0,0 +1,30 @@
+#pragma once
+
+#include "matrix.h"
+
+#include <vector>
+
+template <Scalar T>
+    requires IS_FIELD<T>
+class LUDecomposition {
+public:
+    explicit LUDecomposition(const Matrix<T>& matrix);
+
+    LUDecomposition(const LUDecomposition& other) = default;
+    LUDecomposition(LUDecomposition&& other) = default;
+
+    LUDecomposition& operator=(const LUDecomposition& other) = default;
+    LUDecomposition& operator=(LUDecomposition&& other) = default;
+
+    bool IsSingular() const;
+    T Determinant() const;
+    Matrix<T> Inverted() const;
+    Matrix<T> Solve(const Matrix<T>& rhs) const;
+
+private:
+    // L (unit diagonal, not stored) and U share one square table
+    Matrix<T> lu_;
+    std::vector<size_t> permutation_;
+    bool negative_ = false;
+    bool singular_ = false;
+};
@@ -1,43 +1,214 @@
 #include "args_parser.h"
+#include "charpoly.h"
 #include "matrix.h"
+#include "matrix_file.h"
+#include "sparse_matrix.h"
+#include "thread_pool.h"
+#include "token_reader.h"
 
+#include <algorithm>
+#include <cerrno>
+#include <charconv>
+#include <fstream>
 #include <iostream>
+#include <optional>
+#include <system_error>
+
+#include <fcntl.h>
+#include <unistd.h>
 
 enum class Action {
     INVERT,
     DETERMINANT,
     ADD,
     SUB,
-    MULTIPLY
+    MULTIPLY,
+    RANK,
+    CHARPOLY,
+    CONVERT,
+};
+
+struct RawMatrix {
+    size_t rows = 0;
+    size_t columns = 0;
+    // views into the input of the TokenReader
+    std::vector<std::string_view> elements;
+    // or the matrix of a binary file, its elements are decoded when the matrix is built
+    const BinaryMatrix* binary = nullptr;
+    ScalarKind kind = ScalarKind::INTEGER;
+    size_t nonzeros = 0;
+};
+
+// matrices with at least that many elements and at most that share of nonzeros are kept in CSR form
+constexpr size_t SPARSE_MIN_ELEMENTS = 1024;
+constexpr double SPARSE_MAX_DENSITY = 0.1;
+
+struct Options {
+    Action action;
+    bool latex = false;
+    bool expansion = false;
+    // the result is written there in the binary format instead of printed
+    std::string output;
 };
 
-Matrix ReadMatrix() {
-    std::cout << "Enter height and width:" << std::endl;
-    size_t n, m;
-    std::cin >> n >> m;
-    std::cout << "Enter elements:" << std::endl;
-    std::vector<std::vector<Poly>> matrix(n, std::vector<Poly>(m));
-    for (auto& line : matrix) {
-        for (auto& elem : line) {
-            std::cin >> elem;
+// zero numbers like 0, -0 or 0/7, polys are never counted as zero. Sparse matrices skip zeros,
+// so they are parsed here like the dense elements are, and malformed ones like 0/0 throw.
+bool IsZeroToken(std::string_view token) {
+    if (token.find('x') != std::string_view::npos) {
+        return false;
+    }
+    auto numerator = token.substr(0, token.find('/'));
+    if (numerator.find_first_not_of("+-0") != std::string_view::npos) {
+        return false;
+    }
+    if (token != "0") {
+        if (numerator.size() == token.size()) {
+            ParseScalar<CheckedInt>(token);
+        } else {
+            ParseScalar<Fraction>(token);
         }
     }
-    return Matrix(matrix);
+    return true;
+}
+
+size_t ParseSize(std::string_view token) {
+    size_t result = 0;
+    auto [ptr, error] = std::from_chars(token.data(), token.data() + token.size(), result);
+    if (token.empty() || error != std::errc{} || ptr != token.data() + token.size()) {
+        throw std::invalid_argument("can't parse matrix size " + std::string(token));
+    }
+    return result;
 }
 
-void PrintMatrix(const Matrix& matrix, bool latex) {
+// prompts are shown only when the input is typed in a terminal
+RawMatrix ReadMatrix(TokenReader& reader) {
+    bool interactive = reader.IsInteractive();
+    if (interactive) {
+        std::cout << "Enter height and width:" << std::endl;
+    }
+    RawMatrix matrix;
+    matrix.rows = ParseSize(reader.Next());
+    matrix.columns = ParseSize(reader.Next());
+    if (interactive) {
+        std::cout << "Enter elements:" << std::endl;
+    }
+    matrix.elements.resize(matrix.rows * matrix.columns);
+    for (auto& elem : matrix.elements) {
+        elem = reader.Next();
+        if (elem.empty()) {
+            throw std::invalid_argument("not enough matrix elements");
+        }
+        if (elem.find('x') != std::string_view::npos) {
+            matrix.kind = ScalarKind::POLY;
+        } else if (elem.find('/') != std::string_view::npos) {
+            matrix.kind = std::max(matrix.kind, ScalarKind::FRACTION);
+        }
+        if (!IsZeroToken(elem)) {
+            ++matrix.nonzeros;
+        }
+    }
+    return matrix;
+}
+
+// the --input file, closed at the end, or stdin for an empty path
+class InputDescriptor {
+public:
+    explicit InputDescriptor(const std::string& path) {
+        if (path.empty()) {
+            return;
+        }
+        fd_ = open(path.c_str(), O_RDONLY);
+        if (fd_ < 0) {
+            throw std::system_error(errno, std::generic_category(), "can't open " + path);
+        }
+    }
+
+    ~InputDescriptor() {
+        if (fd_ != STDIN_FILENO) {
+            close(fd_);
+        }
+    }
+
+    InputDescriptor(const InputDescriptor& other) = delete;
+    InputDescriptor& operator=(const InputDescriptor& other) = delete;
+
+    int Get() const {
+        return fd_;
+    }
+
+private:
+    int fd_ = STDIN_FILENO;
+};
+
+RawMatrix FromBinary(const BinaryMatrix& binary) {
+    RawMatrix matrix;
+    matrix.rows = binary.Rows();
+    matrix.columns = binary.Columns();
+    matrix.binary = &binary;
+    matrix.kind = binary.Kind();
+    matrix.nonzeros = binary.NonZeros();
+    return matrix;
+}
+
+template <Scalar T>
+T Element(const RawMatrix& raw, size_t index) {
+    return raw.binary ? raw.binary->Element<T>(index) : ParseScalar<T>(raw.elements[index]);
+}
+
+bool IsZeroElement(const RawMatrix& raw, size_t index) {
+    return raw.binary ? raw.binary->IsZero(index) : IsZeroToken(raw.elements[index]);
+}
+
+bool IsSparse(const RawMatrix& matrix) {
+    size_t size = matrix.rows * matrix.columns;
+    return size >= SPARSE_MIN_ELEMENTS && matrix.nonzeros <= SPARSE_MAX_DENSITY * size;
+}
+
+template <Scalar T>
+Matrix<T> ToMatrix(const RawMatrix& raw) {
+    Matrix<T> matrix(raw.rows, raw.columns);
+    ThreadPool::Instance().ParallelFor(0, raw.rows, [&] (size_t i) {
+        auto line = matrix.Row(i);
+        for (size_t j = 0; j < raw.columns; ++j) {
+            line[j] = Element<T>(raw, i * raw.columns + j);
+        }
+    }, ThreadPool::Grain(raw.columns));
+    return matrix;
+}
+
+template <Scalar T>
+SparseMatrix<T> ToSparseMatrix(const RawMatrix& raw) {
+    std::vector<size_t> row_offsets = {0};
+    std::vector<size_t> column_indices;
+    std::vector<T> values;
+    for (size_t i = 0; i < raw.rows; ++i) {
+        for (size_t j = 0; j < raw.columns; ++j) {
+            if (!IsZeroElement(raw, i * raw.columns + j)) {
+                column_indices.push_back(j);
+                values.push_back(Element<T>(raw, i * raw.columns + j));
+            }
+        }
+        row_offsets.push_back(values.size());
+    }
+    return SparseMatrix<T>(raw.rows, raw.columns, std::move(row_offsets), std::move(column_indices),
+                           std::move(values));
+}
+
+template <Scalar T>
+void PrintMatrix(const Matrix<T>& matrix, bool latex) {
     if (latex) {
         std::cout << "\\begin{pmatrix}" << std::endl;
     }
 
-    for (const auto& line : matrix.GetData()) {
+    for (size_t i = 0; i < matrix.Rows(); ++i) {
+        const auto line = matrix.Row(i);
         bool isFirst = true;
         for (const auto& element : line) {
             if (!isFirst) {
                 std::cout << (latex ? " & " : " ");
             }
             isFirst = false;
-            auto str = element.AsString();
+            auto str = AsString(element);
             if (latex) {
                 if (str.find('x') != std::string::npos) {
                     throw "can't format poly as latex";
@@ -52,7 +223,7 @@ void PrintMatrix(const Matrix& matrix, bool latex) {
         if (latex) {
             std::cout << " \\\\";
         }
-        std::cout << std::endl;
+        std::cout << '\n';
     }
 
     if (latex) {
@@ -60,12 +231,155 @@ void PrintMatrix(const Matrix& matrix, bool latex) {
     }
 }
 
+std::ofstream OpenOutput(const std::string& path) {
+    std::ofstream file(path, std::ios::binary);
+    if (!file) {
+        throw std::system_error(errno, std::generic_category(), "can't open " + path);
+    }
+    return file;
+}
+
+// printed or, with --output, written in the binary format
+template <Scalar T>
+void Output(const Matrix<T>& matrix, const Options& options) {
+    if (options.output.empty()) {
+        PrintMatrix(matrix, options.latex);
+        return;
+    }
+    std::ofstream file = OpenOutput(options.output);
+    BinaryMatrixWriter(file).Write(matrix);
+}
+
+// a number or a poly is written as a 1x1 matrix
+template <Scalar T>
+void OutputScalar(const T& value, const Options& options) {
+    if (options.output.empty()) {
+        std::cout << AsString(value) << std::endl;
+        return;
+    }
+    Matrix<T> matrix(1);
+    matrix(0, 0) = value;
+    Output(matrix, options);
+}
+
+// the text input format, polys without spaces
+template <Scalar T>
+void WriteText(const Matrix<T>& matrix, std::ostream& os) {
+    os << matrix.Rows() << ' ' << matrix.Columns() << '\n';
+    for (size_t i = 0; i < matrix.Rows(); ++i) {
+        for (size_t j = 0; j < matrix.Columns(); ++j) {
+            auto str = AsString(matrix(i, j));
+            std::erase(str, ' ');
+            os << (j == 0 ? "" : " ") << str;
+        }
+        os << '\n';
+    }
+}
+
+// Text input is written in the binary format and binary input as text, to --output or stdout.
+// Numbers go through exact fractions, so integers of any length are kept.
+void Convert(const std::vector<RawMatrix>& inputs, const Options& options) {
+    std::ofstream file;
+    if (!options.output.empty()) {
+        file = OpenOutput(options.output);
+    }
+    std::ostream& os = options.output.empty() ? std::cout : file;
+    BinaryMatrixWriter writer(os);
+    for (const auto& input : inputs) {
+        if (input.binary && input.kind == ScalarKind::POLY) {
+            WriteText(ToMatrix<Poly>(input), os);
+        } else if (input.binary) {
+            WriteText(ToMatrix<Fraction>(input), os);
+        } else if (input.kind == ScalarKind::POLY) {
+            writer.Write(ToMatrix<Poly>(input));
+        } else {
+            writer.Write(ToMatrix<Fraction>(input));
+        }
+    }
+    os.flush();
+}
+
+template <Scalar T>
+void Run(const Options& options, const std::vector<RawMatrix>& inputs) {
+    switch (options.action) {
+        case Action::INVERT: {
+            if constexpr (IS_FIELD<T>) {
+                Output(ToMatrix<T>(inputs[0]).Inverted(), options);
+            } else {
+                Run<Fraction>(options, inputs);
+            }
+            break;
+        }
+        case Action::DETERMINANT: {
+            // integers stay on the overflow checked dense path
+            if constexpr (std::is_same_v<T, Fraction> || std::is_same_v<T, double>) {
+                if (!options.expansion && IsSparse(inputs[0])) {
+                    OutputScalar(ToSparseMatrix<T>(inputs[0]).Determinant(), options);
+                    break;
+                }
+            }
+            auto method = options.expansion ? DeterminantMethod::EXPANSION : DeterminantMethod::AUTO;
+            OutputScalar(ToMatrix<T>(inputs[0]).Determinant(method), options);
+            break;
+        }
+        case Action::ADD: {
+            auto A = ToMatrix<T>(inputs[0]);
+            auto B = ToMatrix<T>(inputs[1]);
+            Output<T>(A + B, options);
+            break;
+        }
+        case Action::SUB: {
+            auto A = ToMatrix<T>(inputs[0]);
+            auto B = ToMatrix<T>(inputs[1]);
+            Output<T>(A - B, options);
+            break;
+        }
+        case Action::MULTIPLY: {
+            if (IsSparse(inputs[0])) {
+                auto A = ToSparseMatrix<T>(inputs[0]);
+                if (IsSparse(inputs[1])) {
+                    Output((A * ToSparseMatrix<T>(inputs[1])).ToDense(), options);
+                } else {
+                    Output(A * ToMatrix<T>(inputs[1]), options);
+                }
+                break;
+            }
+            auto A = ToMatrix<T>(inputs[0]);
+            auto B = ToMatrix<T>(inputs[1]);
+            Output(A * B, options);
+            break;
+        }
+        case Action::RANK: {
+            if constexpr (std::is_same_v<T, CheckedInt> || std::is_same_v<T, Fraction>) {
+                OutputScalar(CheckedInt(static_cast<int64_t>(ToMatrix<T>(inputs[0]).Rank())), options);
+            } else {
+                throw MatrixException("Rank is supported for exact numeric matrices only");
+            }
+            break;
+        }
+        case Action::CHARPOLY: {
+            if constexpr (std::is_same_v<T, CheckedInt> || std::is_same_v<T, Fraction>) {
+                OutputScalar(CharacteristicPolynomial(ToMatrix<T>(inputs[0])), options);
+            } else {
+                throw MatrixException("Characteristic polynomial is supported for exact numeric matrices only");
+            }
+            break;
+        }
+        case Action::CONVERT:
+            break;
+    }
+}
+
 int main(int argc, char* argv[]) {
-    Action action;
-    bool latex;
+    std::ios::sync_with_stdio(false);
+    Options options;
+    bool approximate = false;
+    uint64_t strassen_crossover = GetStrassenCrossover();
+    uint64_t threads = std::thread::hardware_concurrency();
+    std::string input;
     ArgsParser{}
-        .AddLongOption<Action>('a', "action", &action, true,
-            "One of: INVERT, DETERMINANT, ADD, SUB, MULTIPLY",
+        .AddLongOption<Action>('a', "action", &options.action, true,
+            "One of: INVERT, DETERMINANT, ADD, SUB, MULTIPLY, RANK, CHARPOLY, CONVERT",
             [] (const std::string& str) {
                 switch (str[0]) {
                     case 'I': return Action::INVERT;
@@ -73,41 +387,77 @@ int main(int argc, char* argv[]) {
                     case 'A': return Action::ADD;
                     case 'S': return Action::SUB;
                     case 'M': return Action::MULTIPLY;
+                    case 'R': return Action::RANK;
+                    case 'C': return str.starts_with("CO") ? Action::CONVERT : Action::CHARPOLY;
                     default:
                         throw "Unknown option";
                 }
             })
-        .AddLongOption('l', "latex", &latex, false, "print result matrix in latex format")
+        .AddLongOption('l', "latex", &options.latex, false, "print result matrix in latex format")
+        .AddLongOption("expansion", &options.expansion, false,
+            "find determinant by slow permutation expansion, for testing")
+        .AddLongOption('f', "float", &approximate, false, "compute numeric matrices approximately in doubles")
+        .AddLongOption("strassen-crossover", &strassen_crossover, false,
+            "multiply by Strassen-Winograd when all sizes are at least this")
+        .AddLongOption('t', "threads", &threads, false, "number of threads, all hardware threads by default")
+        .AddLongOption('i', "input", &input, false, "read the matrices from this text or binary file instead of stdin")
+        .AddLongOption('o', "output", &options.output, false, "write the result to this file in the binary format")
         .SetHelpMessage("Some actions with matrices. Matrix element is poly with fractions. Write poly without spaces, fractions with /.")
         .Parse(argc, argv);
 
+    SetStrassenCrossover(strassen_crossover);
+    ThreadPool::SetThreadCount(threads);
+
     try {
-        switch (action) {
-            case Action::INVERT: {
-                PrintMatrix(ReadMatrix().Inverted(), latex);
-                break;
-            }
-            case Action::DETERMINANT: {
-                std::cout << ReadMatrix().Determinant() << std::endl;
-                break;
+        // outlives the readers below, which use the descriptor
+        InputDescriptor descriptor(input);
+        int fd = descriptor.Get();
+        size_t count = 1;
+        if (options.action == Action::ADD || options.action == Action::SUB || options.action == Action::MULTIPLY) {
+            count = 2;
+        }
+        // CONVERT takes all the matrices of the input
+        std::optional<BinaryMatrixFile> binary;
+        std::optional<TokenReader> reader;
+        std::vector<RawMatrix> inputs;
+        if (BinaryMatrixFile::IsBinary(fd)) {
+            binary.emplace(fd);
+            for (const auto& matrix : binary->Matrices()) {
+                inputs.push_back(FromBinary(matrix));
             }
-            case Action::ADD: {
-                auto A = ReadMatrix();
-                auto B = ReadMatrix();
-                PrintMatrix(A + B, latex);
-                break;
+            if (options.action != Action::CONVERT) {
+                if (inputs.size() < count) {
+                    throw std::invalid_argument("not enough matrices in the binary input");
+                }
+                inputs.resize(count);
             }
-            case Action::SUB: {
-                auto A = ReadMatrix();
-                auto B = ReadMatrix();
-                PrintMatrix(A - B, latex);
-                break;
+        } else {
+            reader.emplace(fd);
+            while (inputs.size() < count || (options.action == Action::CONVERT && !reader->AtEnd())) {
+                inputs.push_back(ReadMatrix(*reader));
             }
-            case Action::MULTIPLY: {
-                auto A = ReadMatrix();
-                auto B = ReadMatrix();
-                PrintMatrix(A * B, latex);
-                break;
+        }
+        if (options.action == Action::CONVERT) {
+            Convert(inputs, options);
+            return 0;
+        }
+        ScalarKind kind = ScalarKind::INTEGER;
+        for (const auto& input : inputs) {
+            kind = std::max(kind, input.kind);
+        }
+
+        if (kind == ScalarKind::POLY) {
+            Run<Poly>(options, inputs);
+        } else if (approximate) {
+            Run<double>(options, inputs);
+        } else if (kind == ScalarKind::FRACTION) {
+            Run<Fraction>(options, inputs);
+        } else {
+            // int64 first, it is much faster, and exact fractions of any length when it overflows
+            try {
+                Run<CheckedInt>(options, inputs);
+            } catch (const std::overflow_error&) {
+                Run<Fraction>(options, inputs);
             }
         }
     } catch (const std::exception& e) {
@@ -1,34 +1,103 @@
 #include "matrix.h"
 
-Matrix::MatrixException::MatrixException(const std::string& what)
+#include "lu.h"
+#include "modular.h"
+#include "thread_pool.h"
+
+#include <algorithm>
+
+namespace {
+    // a tile of rhs (BLOCK_INNER x BLOCK_COLUMNS elements, for polys with their first nodes) stays in L2
+    constexpr size_t BLOCK_ROWS = 32;
+    constexpr size_t BLOCK_INNER = 64;
+    constexpr size_t BLOCK_COLUMNS = 64;
+
+    // from this size exact numeric determinant and inverse are first tried modulo primes
+    constexpr size_t MODULAR_MIN_SIZE = 8;
+
+    size_t strassen_crossover = 256;
+}
+
+MatrixException::MatrixException(const std::string& what)
     : what_(what)
 {}
 
-const char* Matrix::MatrixException::what() const noexcept {
+const char* MatrixException::what() const noexcept {
     return what_.c_str();
 }
 
-Matrix::Matrix(const size_t N)
+void SetStrassenCrossover(size_t crossover) {
+    strassen_crossover = std::max<size_t>(crossover, 2);
+}
+
+size_t GetStrassenCrossover() {
+    return strassen_crossover;
+}
+
+template <Scalar T>
+Matrix<T>::Matrix(const size_t N)
     : Matrix(N, N)
 {}
 
-Matrix::Matrix(const size_t N, const size_t M)
-    : matrix_(std::vector<std::vector<Poly>>(N, std::vector<Poly>(M, Poly{})))
+template <Scalar T>
+Matrix<T>::Matrix(const size_t N, const size_t M)
+    : rows_(N)
+    , columns_(M)
+    , data_(N * M)
 {}
 
-Matrix::Matrix(std::vector<std::vector<Poly>> matrix)
-    : matrix_(matrix)
-{}
+template <Scalar T>
+Matrix<T>::Matrix(std::vector<std::vector<T>> matrix)
+    : Matrix(matrix.size(), matrix.empty() ? 0 : matrix[0].size())
+{
+    for (size_t i = 0; i < rows_; ++i) {
+        if (matrix[i].size() != columns_) {
+            throw MatrixException("Try to create matrix from lines of different sizes");
+        }
+        std::move(matrix[i].begin(), matrix[i].end(), Row(i).begin());
+    }
+}
 
-Matrix Matrix::UnitMatrix(const size_t N) {
+template <Scalar T>
+Matrix<T> Matrix<T>::UnitMatrix(const size_t N) {
     Matrix unit(N);
     for (size_t i = 0; i < N; ++i) {
-        unit.matrix_[i][i] = Poly{1};
+        unit(i, i) = T{1};
     }
     return unit;
 }
 
-void Matrix::CalculateDeterminant(size_t line, std::vector<bool>& toGo, Poly current, Poly& result) const {
+template <Scalar T>
+Matrix<T> Matrix<T>::Block(size_t row, size_t column, size_t rows, size_t columns) const {
+    Matrix block(rows, columns);
+    size_t copy_rows = row < rows_ ? std::min(rows, rows_ - row) : 0;
+    size_t copy_columns = column < columns_ ? std::min(columns, columns_ - column) : 0;
+    for (size_t i = 0; i < copy_rows; ++i) {
+        auto source = Row(row + i).subspan(column, copy_columns);
+        std::copy(source.begin(), source.end(), block.Row(i).begin());
+    }
+    return block;
+}
+
+template <Scalar T>
+void Matrix<T>::PlaceBlock(size_t row, size_t column, const Matrix& block) {
+    size_t copy_rows = std::min(block.rows_, rows_ - row);
+    size_t copy_columns = std::min(block.columns_, columns_ - column);
+    for (size_t i = 0; i < copy_rows; ++i) {
+        auto source = block.Row(i).first(copy_columns);
+        std::copy(source.begin(), source.end(), Row(row + i).begin() + column);
+    }
+}
+
+template <Scalar T>
+void Matrix<T>::SwapRows(size_t i, size_t j) {
+    if (i != j) {
+        std::swap_ranges(Row(i).begin(), Row(i).end(), Row(j).begin());
+    }
+}
+
+template <Scalar T>
+void Matrix<T>::CalculateDeterminant(size_t line, std::vector<bool>& toGo, T current, T& result) const {
     if (line == toGo.size()) {
         result += current;
         return;
@@ -39,9 +108,9 @@ void Matrix::CalculateDeterminant(size_t line, std::vector<bool>& toGo, Poly cur
             continue;
         }
         toGo[i] = false;
-        auto next = current * matrix_[line][i];
+        auto next = current * (*this)(line, i);
         if (id % 2 == 1) {
-            next *= {-1};
+            next = -next;
         }
         CalculateDeterminant(line + 1, toGo, next, result);
         toGo[i] = true;
@@ -49,125 +118,341 @@ void Matrix::CalculateDeterminant(size_t line, std::vector<bool>& toGo, Poly cur
     }
 }
 
-Poly Matrix::Determinant() const {
-    if (matrix_.size() != matrix_[0].size()) return {0};
-    Poly result = {0};
-    std::vector<bool> toGo(matrix_.size(), true);
-    CalculateDeterminant(0, toGo, Poly{1}, result);
-    return result;
-}
-
-Matrix Matrix::Inverted() const {
-    if (matrix_.size() != matrix_[0].size()) {
-        throw MatrixException("Try to invert non square matrix");
-    }
-
-    if (Determinant() == Poly{0}) {
-        throw MatrixException("Try to invert degenerate matrix");
-    }
-
-    size_t N = matrix_.size();
+template <Scalar T>
+T Matrix<T>::BareissDeterminant() const {
+    size_t N = rows_;
     auto copy = *this;
-    auto one = UnitMatrix(N);
+    bool negative = false;
+    T previous{1};
 
-    for (size_t line = 0; line < N; ++line) {
+    for (size_t line = 0; line + 1 < N; ++line) {
         size_t found = line;
-        while (copy.matrix_[found][line] == Poly{0}) ++found;
+        while (found < N && IsZero(copy(found, line))) ++found;
+        if (found == N) {
+            return T{};
+        }
+        if (found != line) {
+            copy.SwapRows(line, found);
+            negative = !negative;
+        }
 
-        std::swap(copy.matrix_[line], copy.matrix_[found]);
-        std::swap(one.matrix_[line], one.matrix_[found]);
+        ThreadPool::Instance().ParallelFor(line + 1, N, [&] (size_t i) {
+            for (size_t j = line + 1; j < N; ++j) {
+                copy(i, j) *= copy(line, line);
+                copy(i, j) -= copy(i, line) * copy(line, j);
+                copy(i, j) /= previous;
+            }
+        }, ThreadPool::Grain(N - line));
+        previous = copy(line, line);
+    }
 
-        auto val = copy.matrix_[line][line];
+    return negative ? -copy(N - 1, N - 1) : copy(N - 1, N - 1);
+}
 
-        for (size_t j = 0; j < N; ++j) {
-            copy.matrix_[line][j] /= val;
-            one.matrix_[line][j] /= val;
+template <Scalar T>
+T Matrix<T>::Determinant(DeterminantMethod method) const {
+    if (!IsSquare()) {
+        throw MatrixException("Try to find determinant of non square matrix");
+    }
+    // the empty product
+    if (rows_ == 0) {
+        return T{1};
+    }
+    constexpr bool IS_EXACT_NUMBER = std::is_same_v<T, CheckedInt> || std::is_same_v<T, Fraction>;
+    // determinant of an integer matrix is reconstructed as a fraction with denominator 1
+    const auto modular = [this] () -> std::optional<T> {
+        if constexpr (IS_EXACT_NUMBER) {
+            if (auto result = ModularDeterminant(*this)) {
+                if constexpr (std::is_same_v<T, Fraction>) {
+                    return *result;
+                } else {
+                    return result->Numerator();
+                }
+            }
+        } else if constexpr (std::is_same_v<T, Poly>) {
+            return ModularPolyDeterminant(*this);
         }
+        return std::nullopt;
+    };
 
-        for (size_t i = 0; i < N; ++i) {
-            if (i == line) continue;
-            auto coef = copy.matrix_[i][line];
-            for (size_t j = 0; j < N; ++j) {
-                copy.matrix_[i][j] -= copy.matrix_[line][j] * coef;
-                one.matrix_[i][j] -= one.matrix_[line][j] * coef;
+    if (method == DeterminantMethod::AUTO) {
+        bool numbers = true;
+        if constexpr (std::is_same_v<T, Poly>) {
+            numbers = std::all_of(data_.begin(), data_.end(), [] (const Poly& element) { return element.IsNumber(); });
+        }
+        if (rows_ >= MODULAR_MIN_SIZE || !numbers) {
+            if (auto result = modular()) {
+                return *result;
             }
         }
+        if constexpr (!IS_FIELD<T>) {
+            method = DeterminantMethod::BAREISS;
+        } else if constexpr (std::is_same_v<T, Poly>) {
+            method = numbers ? DeterminantMethod::LU : DeterminantMethod::BAREISS;
+        } else {
+            method = DeterminantMethod::LU;
+        }
+    }
+    switch (method) {
+        case DeterminantMethod::LU:
+            if constexpr (IS_FIELD<T>) {
+                return LUDecomposition<T>(*this).Determinant();
+            }
+            throw MatrixException("Try to find determinant by LU over integers");
+        case DeterminantMethod::MODULAR:
+            if (auto result = modular()) {
+                return *result;
+            }
+            throw MatrixException("Can't find determinant modulo primes");
+        case DeterminantMethod::AUTO:
+        case DeterminantMethod::BAREISS:
+            return BareissDeterminant();
+        case DeterminantMethod::EXPANSION:
+            break;
     }
+    T result{};
+    std::vector<bool> toGo(rows_, true);
+    CalculateDeterminant(0, toGo, T{1}, result);
+    return result;
+}
 
-    return one;
+// fraction-free echelon form, every entry stays a minor of the matrix so the divisions are exact
+template <Scalar T>
+size_t Matrix<T>::BareissRank() const {
+    auto copy = *this;
+    T previous{1};
+    size_t rank = 0;
+    for (size_t column = 0; column < columns_ && rank < rows_; ++column) {
+        size_t found = rank;
+        while (found < rows_ && IsZero(copy(found, column))) ++found;
+        if (found == rows_) {
+            continue;
+        }
+        copy.SwapRows(rank, found);
+
+        ThreadPool::Instance().ParallelFor(rank + 1, rows_, [&] (size_t i) {
+            for (size_t j = column + 1; j < columns_; ++j) {
+                copy(i, j) *= copy(rank, column);
+                copy(i, j) -= copy(i, column) * copy(rank, j);
+                copy(i, j) /= previous;
+            }
+        }, ThreadPool::Grain(columns_ - column));
+        previous = copy(rank, column);
+        ++rank;
+    }
+    return rank;
 }
 
-Matrix Matrix::operator-() const {
-    return *this * Poly{-1};
+template <Scalar T>
+size_t Matrix<T>::Rank() const {
+    if constexpr (std::is_same_v<T, CheckedInt> || std::is_same_v<T, Fraction>) {
+        if (auto result = ModularRank(*this)) {
+            return *result;
+        }
+    }
+    return BareissRank();
 }
 
-Matrix& Matrix::operator+=(const Matrix& other) {
-    if (matrix_.size() != other.matrix_.size()
-        || matrix_[0].size() != other.matrix_[0].size())
-    {
-        throw MatrixException("Try to add matrixes of wrong sizes");
+template <Scalar T>
+Matrix<T> Matrix<T>::Inverted() const requires IS_FIELD<T> {
+    if (!IsSquare()) {
+        throw MatrixException("Try to invert non square matrix");
     }
-    for (size_t i = 0; i < matrix_.size(); ++i) {
-        for (size_t j = 0; j < matrix_[0].size(); ++j) {
-            matrix_[i][j] += other.matrix_[i][j];
+
+    if constexpr (std::is_same_v<T, Fraction>) {
+        if (rows_ >= MODULAR_MIN_SIZE) {
+            if (auto result = ModularInverse(*this)) {
+                return std::move(*result);
+            }
         }
     }
-    return *this;
+
+    LUDecomposition<T> lu(*this);
+    if (lu.IsSingular()) {
+        throw MatrixException("Try to invert degenerate matrix");
+    }
+    return lu.Inverted();
 }
 
-Matrix& Matrix::operator-=(const Matrix& other) {
-    return *this += -other;
+template <Scalar T>
+Matrix<Fraction> Matrix<T>::Evaluate(const Fraction& point) const requires std::same_as<T, Poly> {
+    return std::move(Evaluate(std::span(&point, 1))[0]);
 }
 
-Matrix& Matrix::operator*=(const Matrix& other) {
-    if (matrix_[0].size() != other.matrix_.size()) {
-        throw MatrixException("Try to multiply matrixes of wrong sizes");
-    }
-    Matrix result(matrix_.size(), other.matrix_[0].size());
-    for (size_t i = 0; i < matrix_.size(); ++i) {
-        for (size_t j = 0; j < other.matrix_[0].size(); ++j) {
-            for (size_t k = 0; k < matrix_[0].size(); ++k) {
-                result.matrix_[i][j] += matrix_[i][k] * other.matrix_[k][j];
-            }
+template <Scalar T>
+std::vector<Matrix<Fraction>> Matrix<T>::Evaluate(std::span<const Fraction> points) const requires std::same_as<T, Poly> {
+    std::vector<Matrix<Fraction>> result(points.size(), Matrix<Fraction>(rows_, columns_));
+    ThreadPool::Instance().ParallelFor(0, data_.size(), [&] (size_t id) {
+        auto values = data_[id](points);
+        for (size_t k = 0; k < points.size(); ++k) {
+            result[k](id / columns_, id % columns_) = std::move(values[k]);
         }
+    }, ThreadPool::Grain(points.size()));
+    return result;
+}
+
+template <Scalar T>
+Matrix<T>& Matrix<T>::operator+=(const Matrix& other) {
+    if (rows_ != other.rows_ || columns_ != other.columns_) {
+        throw MatrixException("Try to add matrixes of wrong sizes");
+    }
+    for (size_t i = 0; i < data_.size(); ++i) {
+        data_[i] += other.data_[i];
     }
-    std::swap(*this, result);
     return *this;
 }
 
-Matrix& Matrix::operator*=(const Poly& coef) {
-    for (auto& line : matrix_) {
-        for (auto& element : line) {
-            element *= coef;
-        }
+template <Scalar T>
+Matrix<T>& Matrix<T>::operator-=(const Matrix& other) {
+    if (rows_ != other.rows_ || columns_ != other.columns_) {
+        throw MatrixException("Try to add matrixes of wrong sizes");
+    }
+    for (size_t i = 0; i < data_.size(); ++i) {
+        data_[i] -= other.data_[i];
     }
     return *this;
 }
 
-std::vector<std::vector<Poly>> Matrix::GetData() const {
-    return matrix_;
+template <Scalar T>
+Matrix<T> Matrix<T>::MultiplyClassic(const Matrix& lhs, const Matrix& rhs) {
+    Matrix result(lhs.rows_, rhs.columns_);
+    size_t row_blocks = (lhs.rows_ + BLOCK_ROWS - 1) / BLOCK_ROWS;
+    // every row tile of the result is owned by one thread and summed in the same order
+    ThreadPool::Instance().ParallelFor(0, row_blocks, [&] (size_t row_block) {
+        size_t i_block = row_block * BLOCK_ROWS;
+        size_t i_end = std::min(i_block + BLOCK_ROWS, lhs.rows_);
+        // fractions are summed unreduced aside and written out once the tile is done
+        std::vector<Accumulator<T>> sums;
+        if constexpr (!std::is_same_v<Accumulator<T>, T>) {
+            sums.resize((i_end - i_block) * rhs.columns_);
+        }
+        const auto sum_row = [&] (size_t i) {
+            if constexpr (std::is_same_v<Accumulator<T>, T>) {
+                return result.Row(i);
+            } else {
+                return std::span(sums).subspan((i - i_block) * rhs.columns_, rhs.columns_);
+            }
+        };
+        for (size_t k_block = 0; k_block < lhs.columns_; k_block += BLOCK_INNER) {
+            size_t k_end = std::min(k_block + BLOCK_INNER, lhs.columns_);
+            for (size_t j_block = 0; j_block < rhs.columns_; j_block += BLOCK_COLUMNS) {
+                size_t j_end = std::min(j_block + BLOCK_COLUMNS, rhs.columns_);
+                for (size_t i = i_block; i < i_end; ++i) {
+                    auto result_row = sum_row(i);
+                    for (size_t k = k_block; k < k_end; ++k) {
+                        const auto& element = lhs(i, k);
+                        if (IsZero(element)) continue;
+                        auto rhs_row = rhs.Row(k);
+                        for (size_t j = j_block; j < j_end; ++j) {
+                            AddProduct(result_row[j], element, rhs_row[j]);
+                        }
+                    }
+                }
+            }
+        }
+        if constexpr (!std::is_same_v<Accumulator<T>, T>) {
+            for (size_t i = i_block; i < i_end; ++i) {
+                auto result_row = result.Row(i);
+                auto row_sums = sum_row(i);
+                for (size_t j = 0; j < rhs.columns_; ++j) {
+                    result_row[j] = Accumulated<T>(row_sums[j]);
+                }
+            }
+        }
+    });
+    return result;
 }
 
-Matrix operator+(const Matrix& lhs, const Matrix& rhs) {
-    Matrix result = lhs;
-    result += rhs;
+// Winograd form of Strassen: 7 half-size products and 15 additions,
+// odd sizes are padded with zero rows and columns on every level
+template <Scalar T>
+Matrix<T> Matrix<T>::MultiplyStrassen(const Matrix& lhs, const Matrix& rhs) {
+    size_t M = (lhs.rows_ + 1) / 2;
+    size_t K = (lhs.columns_ + 1) / 2;
+    size_t N = (rhs.columns_ + 1) / 2;
+
+    auto A11 = lhs.Block(0, 0, M, K);
+    auto A12 = lhs.Block(0, K, M, K);
+    auto A21 = lhs.Block(M, 0, M, K);
+    auto A22 = lhs.Block(M, K, M, K);
+    auto B11 = rhs.Block(0, 0, K, N);
+    auto B12 = rhs.Block(0, N, K, N);
+    auto B21 = rhs.Block(K, 0, K, N);
+    auto B22 = rhs.Block(K, N, K, N);
+
+    // sums are updated in place once their operands are not needed anymore
+    Matrix S3 = A11 - A21;
+    auto& S1 = A21 += A22;
+    Matrix S2 = S1 - A11;
+    Matrix S4 = A12 - S2;
+    Matrix T3 = B22 - B12;
+    auto& T1 = B12 -= B11;
+    Matrix T2 = B22 - T1;
+    Matrix T4 = T2 - B21;
+
+    Matrix M1, M2, M3, M4, M5, M6, M7;
+    ThreadPool::Instance().Run({
+        [&] { M1 = A11 * B11; },
+        [&] { M2 = A12 * B21; },
+        [&] { M3 = S4 * B22; },
+        [&] { M4 = A22 * T4; },
+        [&] { M5 = S1 * T1; },
+        [&] { M6 = S2 * T2; },
+        [&] { M7 = S3 * T3; },
+    });
+
+    auto& U2 = M6 += M1;
+    auto& C11 = M1 += M2;
+    auto& U3 = M7 += U2;
+    auto& U4 = U2 += M5;
+    auto& C12 = U4 += M3;
+    Matrix C21 = U3 - M4;
+    auto& C22 = U3 += M5;
+
+    Matrix result(lhs.rows_, rhs.columns_);
+    result.PlaceBlock(0, 0, C11);
+    result.PlaceBlock(0, N, C12);
+    result.PlaceBlock(M, 0, C21);
+    result.PlaceBlock(M, N, C22);
     return result;
 }
 
-Matrix operator-(const Matrix& lhs, const Matrix& rhs) {
-    Matrix result = lhs;
-    result -= rhs;
-    return result;
+template <Scalar T>
+Matrix<T> Matrix<T>::Multiply(const Matrix& lhs, const Matrix& rhs) {
+    if (lhs.columns_ != rhs.rows_) {
+        throw MatrixException("Try to multiply matrixes of wrong sizes");
+    }
+    if (std::min({lhs.rows_, lhs.columns_, rhs.columns_}) >= strassen_crossover) {
+        return MultiplyStrassen(lhs, rhs);
+    }
+    return MultiplyClassic(lhs, rhs);
 }
 
-Matrix operator*(const Matrix& lhs, const Matrix& rhs) {
-    Matrix result = lhs;
-    result *= rhs;
-    return result;
+template <Scalar T>
+Matrix<T>& Matrix<T>::operator*=(const Matrix& other) {
+    *this = Multiply(*this, other);
+    return *this;
 }
 
-Matrix operator*(const Matrix& lhs, const Poly& coef) {
-    Matrix result = lhs;
-    result *= coef;
-    return result;
+template <Scalar T>
+Matrix<T>& Matrix<T>::operator*=(const T& coef) {
+    for (auto& element : data_) {
+        element *= coef;
+    }
+    return *this;
+}
+
+template <Scalar T>
+Matrix<T> operator*(const Matrix<T>& lhs, const Matrix<T>& rhs) {
+    return Matrix<T>::Multiply(lhs, rhs);
 }
+
+template class Matrix<CheckedInt>;
+template class Matrix<Fraction>;
+template class Matrix<double>;
+template class Matrix<Poly>;
+
+template Matrix<CheckedInt> operator*(const Matrix<CheckedInt>& lhs, const Matrix<CheckedInt>& rhs);
+template Matrix<Fraction> operator*(const Matrix<Fraction>& lhs, const Matrix<Fraction>& rhs);
+template Matrix<double> operator*(const Matrix<double>& lhs, const Matrix<double>& rhs);
+template Matrix<Poly> operator*(const Matrix<Poly>& lhs, const Matrix<Poly>& rhs);
@@ -1,53 +1,518 @@
 #pragma once
 
-#include "poly.h"
+#include "scalar.h"
 
+#include <concepts>
+#include <span>
 #include <vector>
 
+struct MatrixException : public std::exception {
+    explicit MatrixException(const std::string& what);
+    const char* what() const noexcept override;
+
+private:
+    const std::string what_;
+};
+
+enum class DeterminantMethod {
+    AUTO,
+    LU,
+    BAREISS,
+    MODULAR,
+    EXPANSION,
+};
+
+// products with all sizes at least crossover go through Strassen-Winograd
+void SetStrassenCrossover(size_t crossover);
+size_t GetStrassenCrossover();
+
+template <Scalar T>
+class Matrix;
+
+// Lazy element-wise expression: it can assign or add (with sign) its element
+// number index of the row-major order into a destination scalar, and tells
+// whether it reads a matrix, which then can't be the destination.
+template <typename T>
+concept MatrixExpression = requires(const T& expression, typename T::Element& destination, size_t index,
+                                    const Matrix<typename T::Element>& matrix) {
+    { expression.Rows() } -> std::convertible_to<size_t>;
+    { expression.Columns() } -> std::convertible_to<size_t>;
+    expression.Assign(destination, index);
+    expression.AddTo(destination, index, true);
+    { expression.Aliases(matrix) } -> std::convertible_to<bool>;
+};
+
+template <Scalar T>
 class Matrix {
 public:
-    struct MatrixException : public std::exception {
-        explicit MatrixException(const std::string& what);
-        const char* what() const noexcept override;
-
-    private:
-        const std::string what_;
-    };
+    using MatrixException = ::MatrixException;
+    using DeterminantMethod = ::DeterminantMethod;
+    using Element = T;
 
 public:
     Matrix() = default;
     explicit Matrix(const size_t N);
     Matrix(const size_t N, const size_t M);
-    explicit Matrix(std::vector<std::vector<Poly>> matrix);
+    explicit Matrix(std::vector<std::vector<T>> matrix);
+
+    // evaluates the whole expression in one pass without intermediate matrices
+    template <MatrixExpression Expression>
+        requires std::same_as<typename Expression::Element, T>
+    Matrix(const Expression& expression);
+
+    // element-wise ScalarCast, e.g. integer matrix to fraction one
+    template <Scalar U>
+    explicit Matrix(const Matrix<U>& other);
 
     Matrix(const Matrix& other) = default;
-    Matrix(Matrix&& other) = default;
+    Matrix(Matrix&& other) noexcept = default;
 
     Matrix& operator=(const Matrix& other) = default;
-    Matrix& operator=(Matrix&& other) = default;
+    Matrix& operator=(Matrix&& other) noexcept = default;
 
     static Matrix UnitMatrix(const size_t N);
 
-    Poly Determinant() const;
-    Matrix Inverted() const;
+    T Determinant(DeterminantMethod method = DeterminantMethod::AUTO) const;
+    Matrix Inverted() const requires IS_FIELD<T>;
+    // exact numbers take the rank modulo primes when it is full, otherwise it is found by elimination
+    size_t Rank() const;
+
+    // substitutes x = point into every element
+    Matrix<Fraction> Evaluate(const Fraction& point) const requires std::same_as<T, Poly>;
+    // one matrix per point, every element is evaluated at all the points in one batch
+    std::vector<Matrix<Fraction>> Evaluate(std::span<const Fraction> points) const requires std::same_as<T, Poly>;
 
-    Matrix operator-() const;
     Matrix& operator+=(const Matrix& other);
     Matrix& operator-=(const Matrix& other);
+    // an expression that reads this matrix is evaluated into a temporary first
+    template <MatrixExpression Expression>
+    Matrix& operator+=(const Expression& expression);
+    template <MatrixExpression Expression>
+    Matrix& operator-=(const Expression& expression);
     Matrix& operator*=(const Matrix& other);
-    Matrix& operator*=(const Poly& coef);
+    Matrix& operator*=(const T& coef);
+
+    size_t Rows() const;
+    size_t Columns() const;
+    bool IsSquare() const;
+
+    T& operator()(size_t i, size_t j);
+    const T& operator()(size_t i, size_t j) const;
+
+    // all elements in row-major order
+    std::span<const T> Data() const;
+
+    // rows are stored one after another, so a row view is a plain span
+    std::span<T> Row(size_t i);
+    std::span<const T> Row(size_t i) const;
+
+    void SwapRows(size_t i, size_t j);
 
-    std::vector<std::vector<Poly>> GetData() const;
+    template <Scalar U>
+    friend Matrix<U> operator*(const Matrix<U>& lhs, const Matrix<U>& rhs);
 
 private:
-    void CalculateDeterminant(size_t i, std::vector<bool>& toGo, Poly current, Poly& result) const;
+    static Matrix Multiply(const Matrix& lhs, const Matrix& rhs);
+    static Matrix MultiplyClassic(const Matrix& lhs, const Matrix& rhs);
+    static Matrix MultiplyStrassen(const Matrix& lhs, const Matrix& rhs);
+
+    Matrix Block(size_t row, size_t column, size_t rows, size_t columns) const;
+    void PlaceBlock(size_t row, size_t column, const Matrix& block);
+
+    T BareissDeterminant() const;
+    size_t BareissRank() const;
+    void CalculateDeterminant(size_t i, std::vector<bool>& toGo, T current, T& result) const;
 
 private:
-    std::vector<std::vector<Poly>> matrix_;
+    size_t rows_ = 0;
+    size_t columns_ = 0;
+    std::vector<T> data_;
+
+};
+
+template <Scalar T>
+class MatrixReference {
+public:
+    using Element = T;
 
+    explicit MatrixReference(const Matrix<T>& matrix);
+
+    size_t Rows() const;
+    size_t Columns() const;
+    void Assign(T& destination, size_t index) const;
+    void AddTo(T& destination, size_t index, bool negative) const;
+    void AddScaledTo(T& destination, size_t index, const T& coef, bool negative) const;
+    bool Aliases(const Matrix<T>& matrix) const;
+
+private:
+    const Matrix<T>& matrix_;
+};
+
+template <MatrixExpression Lhs, MatrixExpression Rhs, bool Subtract>
+    requires std::same_as<typename Lhs::Element, typename Rhs::Element>
+class MatrixSum {
+public:
+    using Element = typename Lhs::Element;
+
+    MatrixSum(Lhs lhs, Rhs rhs);
+
+    size_t Rows() const;
+    size_t Columns() const;
+    void Assign(Element& destination, size_t index) const;
+    void AddTo(Element& destination, size_t index, bool negative) const;
+    bool Aliases(const Matrix<Element>& matrix) const;
+
+private:
+    Lhs lhs_;
+    Rhs rhs_;
+};
+
+template <MatrixExpression Expression>
+class MatrixNegation {
+public:
+    using Element = typename Expression::Element;
+
+    explicit MatrixNegation(Expression expression);
+
+    size_t Rows() const;
+    size_t Columns() const;
+    void Assign(Element& destination, size_t index) const;
+    void AddTo(Element& destination, size_t index, bool negative) const;
+    bool Aliases(const Matrix<Element>& matrix) const;
+
+private:
+    Expression expression_;
+};
+
+// scaling of a plain matrix is fused into the destination, others need one temporary per element
+template <MatrixExpression Expression>
+class MatrixScale {
+public:
+    using Element = typename Expression::Element;
+
+    MatrixScale(Expression expression, Element coef);
+
+    size_t Rows() const;
+    size_t Columns() const;
+    void Assign(Element& destination, size_t index) const;
+    void AddTo(Element& destination, size_t index, bool negative) const;
+    bool Aliases(const Matrix<Element>& matrix) const;
+
+private:
+    Expression expression_;
+    Element coef_;
 };
 
-Matrix operator+(const Matrix& lhs, const Matrix& rhs);
-Matrix operator-(const Matrix& lhs, const Matrix& rhs);
-Matrix operator*(const Matrix& lhs, const Matrix& rhs);
-Matrix operator*(const Matrix& lhs, const Poly& coef);
+template <typename T>
+inline constexpr bool IS_MATRIX = false;
+
+template <Scalar T>
+inline constexpr bool IS_MATRIX<Matrix<T>> = true;
+
+template <typename T>
+concept MatrixOperand = IS_MATRIX<T> || MatrixExpression<T>;
+
+template <Scalar T>
+MatrixReference<T> AsExpression(const Matrix<T>& matrix) {
+    return MatrixReference<T>(matrix);
+}
+
+template <MatrixExpression Expression>
+const Expression& AsExpression(const Expression& expression) {
+    return expression;
+}
+
+template <typename T>
+using ExpressionOf = std::remove_cvref_t<decltype(AsExpression(std::declval<const T&>()))>;
+
+template <MatrixOperand Lhs, MatrixOperand Rhs>
+MatrixSum<ExpressionOf<Lhs>, ExpressionOf<Rhs>, false> operator+(const Lhs& lhs, const Rhs& rhs) {
+    return {AsExpression(lhs), AsExpression(rhs)};
+}
+
+template <MatrixOperand Lhs, MatrixOperand Rhs>
+MatrixSum<ExpressionOf<Lhs>, ExpressionOf<Rhs>, true> operator-(const Lhs& lhs, const Rhs& rhs) {
+    return {AsExpression(lhs), AsExpression(rhs)};
+}
+
+template <MatrixOperand Operand>
+MatrixNegation<ExpressionOf<Operand>> operator-(const Operand& operand) {
+    return MatrixNegation<ExpressionOf<Operand>>(AsExpression(operand));
+}
+
+template <MatrixOperand Operand>
+MatrixScale<ExpressionOf<Operand>> operator*(const Operand& operand,
+                                             const typename ExpressionOf<Operand>::Element& coef) {
+    return {AsExpression(operand), coef};
+}
+
+// A temporary lhs is updated in place and returned, instead of a lazy expression that refers to it.
+// The elements are computed by the same operations, so the result doesn't change.
+template <Scalar T, MatrixOperand Rhs>
+    requires std::same_as<typename ExpressionOf<Rhs>::Element, T>
+Matrix<T> operator+(Matrix<T>&& lhs, const Rhs& rhs) {
+    lhs += rhs;
+    return std::move(lhs);
+}
+
+template <Scalar T, MatrixOperand Rhs>
+    requires std::same_as<typename ExpressionOf<Rhs>::Element, T>
+Matrix<T> operator-(Matrix<T>&& lhs, const Rhs& rhs) {
+    lhs -= rhs;
+    return std::move(lhs);
+}
+
+// the product is built into a new matrix, operands are never copied
+template <Scalar T>
+Matrix<T> operator*(const Matrix<T>& lhs, const Matrix<T>& rhs);
+
+template <Scalar T>
+size_t Matrix<T>::Rows() const {
+    return rows_;
+}
+
+template <Scalar T>
+size_t Matrix<T>::Columns() const {
+    return columns_;
+}
+
+template <Scalar T>
+bool Matrix<T>::IsSquare() const {
+    return rows_ == columns_;
+}
+
+template <Scalar T>
+T& Matrix<T>::operator()(size_t i, size_t j) {
+    return data_[i * columns_ + j];
+}
+
+template <Scalar T>
+const T& Matrix<T>::operator()(size_t i, size_t j) const {
+    return data_[i * columns_ + j];
+}
+
+template <Scalar T>
+std::span<const T> Matrix<T>::Data() const {
+    return data_;
+}
+
+template <Scalar T>
+std::span<T> Matrix<T>::Row(size_t i) {
+    return {data_.data() + i * columns_, columns_};
+}
+
+template <Scalar T>
+std::span<const T> Matrix<T>::Row(size_t i) const {
+    return {data_.data() + i * columns_, columns_};
+}
+
+template <Scalar T>
+template <MatrixExpression Expression>
+    requires std::same_as<typename Expression::Element, T>
+Matrix<T>::Matrix(const Expression& expression)
+    : Matrix(expression.Rows(), expression.Columns())
+{
+    for (size_t i = 0; i < data_.size(); ++i) {
+        expression.Assign(data_[i], i);
+    }
+}
+
+template <Scalar T>
+template <Scalar U>
+Matrix<T>::Matrix(const Matrix<U>& other)
+    : Matrix(other.Rows(), other.Columns())
+{
+    auto source = other.Data();
+    for (size_t i = 0; i < data_.size(); ++i) {
+        data_[i] = ScalarCast<T>(source[i]);
+    }
+}
+
+template <Scalar T>
+template <MatrixExpression Expression>
+Matrix<T>& Matrix<T>::operator+=(const Expression& expression) {
+    if (rows_ != expression.Rows() || columns_ != expression.Columns()) {
+        throw MatrixException("Try to add matrixes of wrong sizes");
+    }
+    if (expression.Aliases(*this)) {
+        return *this += Matrix(expression);
+    }
+    for (size_t i = 0; i < data_.size(); ++i) {
+        expression.AddTo(data_[i], i, false);
+    }
+    return *this;
+}
+
+template <Scalar T>
+template <MatrixExpression Expression>
+Matrix<T>& Matrix<T>::operator-=(const Expression& expression) {
+    if (rows_ != expression.Rows() || columns_ != expression.Columns()) {
+        throw MatrixException("Try to add matrixes of wrong sizes");
+    }
+    if (expression.Aliases(*this)) {
+        return *this -= Matrix(expression);
+    }
+    for (size_t i = 0; i < data_.size(); ++i) {
+        expression.AddTo(data_[i], i, true);
+    }
+    return *this;
+}
+
+template <Scalar T>
+MatrixReference<T>::MatrixReference(const Matrix<T>& matrix)
+    : matrix_(matrix)
+{}
+
+template <Scalar T>
+size_t MatrixReference<T>::Rows() const {
+    return matrix_.Rows();
+}
+
+template <Scalar T>
+size_t MatrixReference<T>::Columns() const {
+    return matrix_.Columns();
+}
+
+template <Scalar T>
+void MatrixReference<T>::Assign(T& destination, size_t index) const {
+    destination = matrix_.Data()[index];
+}
+
+template <Scalar T>
+void MatrixReference<T>::AddTo(T& destination, size_t index, bool negative) const {
+    if (negative) {
+        destination -= matrix_.Data()[index];
+    } else {
+        destination += matrix_.Data()[index];
+    }
+}
+
+template <Scalar T>
+void MatrixReference<T>::AddScaledTo(T& destination, size_t index, const T& coef, bool negative) const {
+    if (negative) {
+        SubProduct(destination, matrix_.Data()[index], coef);
+    } else {
+        AddProduct(destination, matrix_.Data()[index], coef);
+    }
+}
+
+template <Scalar T>
+bool MatrixReference<T>::Aliases(const Matrix<T>& matrix) const {
+    return &matrix_ == &matrix;
+}
+
+template <MatrixExpression Lhs, MatrixExpression Rhs, bool Subtract>
+    requires std::same_as<typename Lhs::Element, typename Rhs::Element>
+MatrixSum<Lhs, Rhs, Subtract>::MatrixSum(Lhs lhs, Rhs rhs)
+    : lhs_(std::move(lhs))
+    , rhs_(std::move(rhs))
+{
+    if (lhs_.Rows() != rhs_.Rows() || lhs_.Columns() != rhs_.Columns()) {
+        throw MatrixException("Try to add matrixes of wrong sizes");
+    }
+}
+
+template <MatrixExpression Lhs, MatrixExpression Rhs, bool Subtract>
+    requires std::same_as<typename Lhs::Element, typename Rhs::Element>
+size_t MatrixSum<Lhs, Rhs, Subtract>::Rows() const {
+    return lhs_.Rows();
+}
+
+template <MatrixExpression Lhs, MatrixExpression Rhs, bool Subtract>
+    requires std::same_as<typename Lhs::Element, typename Rhs::Element>
+size_t MatrixSum<Lhs, Rhs, Subtract>::Columns() const {
+    return lhs_.Columns();
+}
+
+template <MatrixExpression Lhs, MatrixExpression Rhs, bool Subtract>
+    requires std::same_as<typename Lhs::Element, typename Rhs::Element>
+void MatrixSum<Lhs, Rhs, Subtract>::Assign(Element& destination, size_t index) const {
+    lhs_.Assign(destination, index);
+    rhs_.AddTo(destination, index, Subtract);
+}
+
+template <MatrixExpression Lhs, MatrixExpression Rhs, bool Subtract>
+    requires std::same_as<typename Lhs::Element, typename Rhs::Element>
+void MatrixSum<Lhs, Rhs, Subtract>::AddTo(Element& destination, size_t index, bool negative) const {
+    lhs_.AddTo(destination, index, negative);
+    rhs_.AddTo(destination, index, negative != Subtract);
+}
+
+template <MatrixExpression Lhs, MatrixExpression Rhs, bool Subtract>
+    requires std::same_as<typename Lhs::Element, typename Rhs::Element>
+bool MatrixSum<Lhs, Rhs, Subtract>::Aliases(const Matrix<Element>& matrix) const {
+    return lhs_.Aliases(matrix) || rhs_.Aliases(matrix);
+}
+
+template <MatrixExpression Expression>
+MatrixNegation<Expression>::MatrixNegation(Expression expression)
+    : expression_(std::move(expression))
+{}
+
+template <MatrixExpression Expression>
+size_t MatrixNegation<Expression>::Rows() const {
+    return expression_.Rows();
+}
+
+template <MatrixExpression Expression>
+size_t MatrixNegation<Expression>::Columns() const {
+    return expression_.Columns();
+}
+
+template <MatrixExpression Expression>
+void MatrixNegation<Expression>::Assign(Element& destination, size_t index) const {
+    destination = Element{};
+    expression_.AddTo(destination, index, true);
+}
+
+template <MatrixExpression Expression>
+void MatrixNegation<Expression>::AddTo(Element& destination, size_t index, bool negative) const {
+    expression_.AddTo(destination, index, !negative);
+}
+
+template <MatrixExpression Expression>
+bool MatrixNegation<Expression>::Aliases(const Matrix<Element>& matrix) const {
+    return expression_.Aliases(matrix);
+}
+
+template <MatrixExpression Expression>
+MatrixScale<Expression>::MatrixScale(Expression expression, Element coef)
+    : expression_(std::move(expression))
+    , coef_(std::move(coef))
+{}
+
+template <MatrixExpression Expression>
+size_t MatrixScale<Expression>::Rows() const {
+    return expression_.Rows();
+}
+
+template <MatrixExpression Expression>
+size_t MatrixScale<Expression>::Columns() const {
+    return expression_.Columns();
+}
+
+template <MatrixExpression Expression>
+void MatrixScale<Expression>::Assign(Element& destination, size_t index) const {
+    destination = Element{};
+    AddTo(destination, index, false);
+}
+
+template <MatrixExpression Expression>
+void MatrixScale<Expression>::AddTo(Element& destination, size_t index, bool negative) const {
+    if constexpr (std::same_as<Expression, MatrixReference<Element>>) {
+        expression_.AddScaledTo(destination, index, coef_, negative);
+    } else {
+        Element element;
+        expression_.Assign(element, index);
+        if (negative) {
+            SubProduct(destination, element, coef_);
+        } else {
+            AddProduct(destination, element, coef_);
+        }
+    }
+}
+
+template <MatrixExpression Expression>
+bool MatrixScale<Expression>::Aliases(const Matrix<Element>& matrix) const {
+    return expression_.Aliases(matrix);
+}
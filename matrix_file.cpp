@@ -0,0 +1,312 @@
+#include "matrix_file.h"
+
+#include <algorithm>
+#include <bit>
+#include <cerrno>
+#include <cmath>
+#include <stdexcept>
+#include <system_error>
+#include <type_traits>
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace {
+    static_assert(std::endian::native == std::endian::little, "binary matrix files are little-endian");
+
+    // "MTXBIN", version 1, 0
+    constexpr uint64_t MAGIC = 0x00'01'4E'49'42'58'54'4Dull;
+    // magic, kind, rows, columns, nonzeros, data words
+    constexpr size_t HEADER_WORDS = 6;
+
+    [[noreturn]] void Fail(const std::string& what) {
+        throw std::invalid_argument("bad binary matrix file: " + what);
+    }
+
+    // the fraction at words[position], position is moved past it
+    Fraction ReadFraction(std::span<const uint64_t> words, size_t& position) {
+        const auto take = [&] (uint64_t count) {
+            if (words.size() - position < count) {
+                Fail("element is cut off");
+            }
+            auto result = words.subspan(position, count);
+            position += count;
+            return result;
+        };
+        auto head = take(2);
+        auto up = static_cast<int64_t>(head[0]);
+        auto down = static_cast<int64_t>(head[1]);
+        if (down > 0) {
+            return Fraction(up, down);
+        }
+        if (down < 0) {
+            Fail("negative denominator");
+        }
+        uint64_t up_size = up < 0 ? 0 - static_cast<uint64_t>(up) : static_cast<uint64_t>(up);
+        uint64_t down_size = take(1)[0];
+        auto up_limbs = take(up_size);
+        auto down_limbs = take(down_size);
+        BigInt big_down = BigInt::FromMagnitude(down_limbs, false);
+        if (big_down.IsZero()) {
+            Fail("zero denominator");
+        }
+        return Fraction(BigInt::FromMagnitude(up_limbs, up < 0), std::move(big_down));
+    }
+
+    void AppendFraction(const Fraction& value, std::vector<uint64_t>& data) {
+        if (value.IsSmall()) {
+            data.push_back(static_cast<uint64_t>(value.Numerator()));
+            data.push_back(static_cast<uint64_t>(value.Denominator()));
+            return;
+        }
+        BigInt up = value.BigNumerator();
+        BigInt down = value.BigDenominator();
+        auto up_limbs = up.Magnitude();
+        auto down_limbs = down.Magnitude();
+        data.push_back(up.IsNegative() ? 0 - up_limbs.size() : up_limbs.size());
+        data.push_back(0);
+        data.push_back(down_limbs.size());
+        data.insert(data.end(), up_limbs.begin(), up_limbs.end());
+        data.insert(data.end(), down_limbs.begin(), down_limbs.end());
+    }
+
+    // a finite double is mantissa * 2^exponent for an integer mantissa of 53 bits
+    Fraction ExactFraction(double value) {
+        if (!std::isfinite(value)) {
+            throw std::domain_error("can't write " + AsString(value) + " as a fraction");
+        }
+        int exponent = 0;
+        auto mantissa = static_cast<int64_t>(std::ldexp(std::frexp(value, &exponent), 53));
+        exponent -= 53;
+        uint64_t shift = exponent < 0 ? -static_cast<int64_t>(exponent) : exponent;
+        std::vector<uint64_t> power(shift / 64 + 1, 0);
+        power.back() = uint64_t{1} << (shift % 64);
+        BigInt scale = BigInt::FromMagnitude(power, false);
+        if (exponent >= 0) {
+            return Fraction(BigInt(mantissa) * scale, BigInt(1));
+        }
+        return Fraction(BigInt(mantissa), std::move(scale));
+    }
+
+    // value of a number element, polys are numbers only when the whole matrix is
+    template <Scalar T>
+    Fraction NumberOf(const T& value) {
+        if constexpr (std::is_same_v<T, CheckedInt>) {
+            return Fraction(value.Value());
+        } else if constexpr (std::is_same_v<T, double>) {
+            return ExactFraction(value);
+        } else if constexpr (std::is_same_v<T, Poly>) {
+            return value.IsZero() ? Fraction() : value.Leading();
+        } else {
+            return value;
+        }
+    }
+}
+
+BinaryMatrix::BinaryMatrix(std::span<const uint64_t> header, std::span<const uint64_t> offsets,
+                           std::span<const uint64_t> data)
+    : rows_(header[2])
+    , columns_(header[3])
+    , kind_(static_cast<ScalarKind>(header[1]))
+    , nonzeros_(header[4])
+    , offsets_(offsets)
+    , data_(data)
+{}
+
+size_t BinaryMatrix::Rows() const {
+    return rows_;
+}
+
+size_t BinaryMatrix::Columns() const {
+    return columns_;
+}
+
+ScalarKind BinaryMatrix::Kind() const {
+    return kind_;
+}
+
+size_t BinaryMatrix::NonZeros() const {
+    return nonzeros_;
+}
+
+std::span<const uint64_t> BinaryMatrix::ElementWords(size_t index) const {
+    return data_.subspan(offsets_[index], offsets_[index + 1] - offsets_[index]);
+}
+
+bool BinaryMatrix::IsZero(size_t index) const {
+    auto words = ElementWords(index);
+    if (kind_ == ScalarKind::POLY) {
+        return words.empty();
+    }
+    return words.size() >= 2 && words[0] == 0 && words[1] != 0;
+}
+
+template <Scalar T>
+T BinaryMatrix::Element(size_t index) const {
+    auto words = ElementWords(index);
+    size_t position = 0;
+    if (kind_ == ScalarKind::POLY) {
+        if constexpr (std::is_same_v<T, Poly>) {
+            std::vector<std::pair<uint64_t, Fraction>> terms;
+            while (position < words.size()) {
+                uint64_t exponent = words[position++];
+                terms.emplace_back(exponent, ReadFraction(words, position));
+            }
+            // input matrices repeat their entries a lot
+            Poly result(std::move(terms));
+            result.Intern();
+            return result;
+        } else {
+            throw std::invalid_argument("poly matrix can't be computed in numbers");
+        }
+    }
+    Fraction value = ReadFraction(words, position);
+    if (position != words.size()) {
+        Fail("extra words after a number");
+    }
+    if constexpr (std::is_same_v<T, CheckedInt>) {
+        // throws std::overflow_error for longer integers, like parsing them
+        CheckedInt result(value.Numerator());
+        if (value.Denominator() != 1) {
+            Fail("fraction in an integer matrix");
+        }
+        return result;
+    } else {
+        return ScalarCast<T>(value);
+    }
+}
+
+BinaryMatrixFile::BinaryMatrixFile(int fd) {
+    struct stat info;
+    if (fstat(fd, &info) != 0 || !S_ISREG(info.st_mode)) {
+        throw std::invalid_argument("binary matrix input must be a regular file");
+    }
+    size_ = info.st_size;
+    if (size_ % sizeof(uint64_t) != 0) {
+        Fail("size is not a whole number of words");
+    }
+    if (size_ == 0) {
+        return;
+    }
+    void* mapped = mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (mapped == MAP_FAILED) {
+        throw std::system_error(errno, std::generic_category(), "can't map binary matrix file");
+    }
+    mapped_ = mapped;
+
+    std::span<const uint64_t> words(static_cast<const uint64_t*>(mapped), size_ / sizeof(uint64_t));
+    try {
+        while (!words.empty()) {
+            if (words.size() < HEADER_WORDS || words[0] != MAGIC) {
+                Fail("no matrix header");
+            }
+            auto header = words.first(HEADER_WORDS);
+            words = words.subspan(HEADER_WORDS);
+            uint64_t rows = header[2];
+            uint64_t columns = header[3];
+            if (header[1] > static_cast<uint64_t>(ScalarKind::POLY)) {
+                Fail("unknown element kind");
+            }
+            // every element has an offset word, so there can't be more of them than words
+            if (columns != 0 && rows > words.size() / columns) {
+                Fail("offsets are cut off");
+            }
+            size_t elements = rows * columns;
+            if (elements + 1 > words.size()) {
+                Fail("offsets are cut off");
+            }
+            auto offsets = words.first(elements + 1);
+            words = words.subspan(elements + 1);
+            if (header[5] > words.size()) {
+                Fail("data is cut off");
+            }
+            auto data = words.first(header[5]);
+            words = words.subspan(header[5]);
+            if (offsets.front() != 0 || offsets.back() != data.size() || !std::is_sorted(offsets.begin(), offsets.end())) {
+                Fail("offsets are out of order");
+            }
+            matrices_.emplace_back(header, offsets, data);
+        }
+    } catch (...) {
+        munmap(mapped_, size_);
+        throw;
+    }
+}
+
+BinaryMatrixFile::~BinaryMatrixFile() {
+    if (mapped_) {
+        munmap(mapped_, size_);
+    }
+}
+
+bool BinaryMatrixFile::IsBinary(int fd) {
+    struct stat info;
+    uint64_t magic = 0;
+    return fstat(fd, &info) == 0 && S_ISREG(info.st_mode)
+        && pread(fd, &magic, sizeof(magic), 0) == sizeof(magic) && magic == MAGIC;
+}
+
+std::span<const BinaryMatrix> BinaryMatrixFile::Matrices() const {
+    return matrices_;
+}
+
+BinaryMatrixWriter::BinaryMatrixWriter(std::ostream& os)
+    : os_(os)
+{}
+
+template <Scalar T>
+void BinaryMatrixWriter::Write(const Matrix<T>& matrix) {
+    auto elements = matrix.Data();
+    ScalarKind kind = ScalarKind::INTEGER;
+    if constexpr (std::is_same_v<T, Poly>) {
+        // polys are written as terms unless all of them are numbers
+        if (std::any_of(elements.begin(), elements.end(), [] (const Poly& element) { return !element.IsNumber(); })) {
+            kind = ScalarKind::POLY;
+        }
+    }
+
+    size_t nonzeros = 0;
+    std::vector<uint64_t> offsets = {0};
+    offsets.reserve(elements.size() + 1);
+    std::vector<uint64_t> data;
+    for (const auto& element : elements) {
+        nonzeros += !::IsZero(element);
+        if constexpr (std::is_same_v<T, Poly>) {
+            if (kind == ScalarKind::POLY) {
+                for (const auto& [exponent, coefficient] : element.Terms()) {
+                    data.push_back(exponent);
+                    AppendFraction(coefficient, data);
+                }
+                offsets.push_back(data.size());
+                continue;
+            }
+        }
+        Fraction value = NumberOf(element);
+        if (value.IsSmall() ? value.Denominator() != 1 : value.BigDenominator() != BigInt(1)) {
+            kind = ScalarKind::FRACTION;
+        }
+        AppendFraction(value, data);
+        offsets.push_back(data.size());
+    }
+
+    const uint64_t header[HEADER_WORDS] = {
+        MAGIC, static_cast<uint64_t>(kind), matrix.Rows(), matrix.Columns(), nonzeros, data.size(),
+    };
+    os_.write(reinterpret_cast<const char*>(header), sizeof(header));
+    os_.write(reinterpret_cast<const char*>(offsets.data()), offsets.size() * sizeof(uint64_t));
+    os_.write(reinterpret_cast<const char*>(data.data()), data.size() * sizeof(uint64_t));
+    if (!os_) {
+        throw std::runtime_error("can't write binary matrix");
+    }
+}
+
+template CheckedInt BinaryMatrix::Element<CheckedInt>(size_t index) const;
+template Fraction BinaryMatrix::Element<Fraction>(size_t index) const;
+template double BinaryMatrix::Element<double>(size_t index) const;
+template Poly BinaryMatrix::Element<Poly>(size_t index) const;
+
+template void BinaryMatrixWriter::Write(const Matrix<CheckedInt>& matrix);
+template void BinaryMatrixWriter::Write(const Matrix<Fraction>& matrix);
+template void BinaryMatrixWriter::Write(const Matrix<double>& matrix);
+template void BinaryMatrixWriter::Write(const Matrix<Poly>& matrix);
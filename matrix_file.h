@@ -0,0 +1,85 @@
+#pragma once
+
+#include "matrix.h"
+
+#include <cstdint>
+#include <ostream>
+#include <span>
+#include <vector>
+
+// element types in the order of growing cost, input is computed in the cheapest one that fits
+enum class ScalarKind {
+    INTEGER,
+    FRACTION,
+    POLY,
+};
+
+// Binary matrix files: a sequence of matrices, each of them made of little-endian 64-bit words
+//   header   magic "MTXBIN" with the version, ScalarKind, rows, columns, nonzero elements,
+//            the number of data words
+//   offsets  rows * columns + 1 words, the element i (row-major) takes data[offsets[i], offsets[i + 1])
+//   data     numbers are one fraction, polys are their nonzero terms by growing exponent, every term
+//            an exponent followed by a fraction, zero is empty
+// A fraction is up, down for int64 values with down > 0, like in Fraction a zero down marks the
+// big form: signed numerator limb count, 0, denominator limb count and then the limbs.
+// The elements are decoded right from the mapped file, nothing is parsed or read into a buffer.
+
+// one matrix of a mapped file, valid while the file is
+class BinaryMatrix {
+public:
+    BinaryMatrix(std::span<const uint64_t> header, std::span<const uint64_t> offsets, std::span<const uint64_t> data);
+
+    size_t Rows() const;
+    size_t Columns() const;
+    ScalarKind Kind() const;
+    size_t NonZeros() const;
+
+    bool IsZero(size_t index) const;
+    // element number index in the row-major order, widened to T like ScalarCast
+    template <Scalar T>
+    T Element(size_t index) const;
+
+private:
+    std::span<const uint64_t> ElementWords(size_t index) const;
+
+private:
+    size_t rows_;
+    size_t columns_;
+    ScalarKind kind_;
+    size_t nonzeros_;
+    std::span<const uint64_t> offsets_;
+    std::span<const uint64_t> data_;
+};
+
+// All matrices of a file, which is mapped into memory and checked to be well formed
+class BinaryMatrixFile {
+public:
+    explicit BinaryMatrixFile(int fd);
+    ~BinaryMatrixFile();
+
+    BinaryMatrixFile(const BinaryMatrixFile& other) = delete;
+    BinaryMatrixFile& operator=(const BinaryMatrixFile& other) = delete;
+
+    // a regular file starting with the magic, pipes and terminals are never binary
+    static bool IsBinary(int fd);
+
+    std::span<const BinaryMatrix> Matrices() const;
+
+private:
+    void* mapped_ = nullptr;
+    size_t size_ = 0;
+    std::vector<BinaryMatrix> matrices_;
+};
+
+// Appends matrices to a stream in the binary format, the kind is the cheapest one that holds
+// the elements. Doubles are written as the exact fractions they are.
+class BinaryMatrixWriter {
+public:
+    explicit BinaryMatrixWriter(std::ostream& os);
+
+    template <Scalar T>
+    void Write(const Matrix<T>& matrix);
+
+private:
+    std::ostream& os_;
+};
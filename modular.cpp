@@ -0,0 +1,1086 @@
+#include "modular.h"
+
+#include "montgomery.h"
+#include "poly_multiply.h"
+#include "thread_pool.h"
+
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <cmath>
+#include <limits>
+#include <numeric>
+#include <random>
+#include <unordered_set>
+
+namespace {
+    // primes computed at once before the first stability check, later batches take a prime per thread
+    constexpr size_t FIRST_BATCH = 2;
+    // an answer reconstructed before the modulus passes its bound is taken after that many more random
+    // primes agree with it, a wrong one of b bits agrees with a random prime with probability below b / 10^9
+    constexpr size_t EARLY_CONFIRMATIONS = 3;
+    // the rank is the largest rank modulo that many random primes
+    constexpr size_t RANK_PRIMES = 2;
+    // answers without a bound on their size are given up after that many bits of primes
+    constexpr size_t UNBOUNDED_MAX_BITS = 2048;
+    // polys are reduced into dense residue vectors or evaluated at that many points only up to that degree
+    constexpr uint64_t MODULAR_POLY_MAX_DEGREE = 1 << 20;
+    // poly determinants are interpolated only when at least 1 / SPARSE_FILL_FACTOR of the coefficients can be nonzero
+    constexpr uint64_t SPARSE_FILL_FACTOR = 4;
+
+    // values of more bits than that are left to Horner
+    constexpr size_t MULTIPOINT_MAX_BITS = 2048;
+    // points under a leaf of the subproduct tree, they are evaluated by Horner
+    constexpr size_t MULTIPOINT_LEAF_POINTS = 16;
+
+
+    // row-major matrix of Montgomery residues
+    struct ModularMatrix {
+        size_t rows;
+        size_t columns;
+        std::vector<uint32_t> data;
+
+        uint32_t* Row(size_t i) {
+            return data.data() + i * columns;
+        }
+    };
+
+    // nullopt if the prime divides some denominator
+    template <Scalar T>
+    std::optional<ModularMatrix> Reduce(const Matrix<T>& matrix, const Montgomery& field) {
+        ModularMatrix result{matrix.Rows(), matrix.Columns(), std::vector<uint32_t>(matrix.Data().size())};
+        auto source = matrix.Data();
+        for (size_t i = 0; i < source.size(); ++i) {
+            if constexpr (std::is_same_v<T, CheckedInt>) {
+                result.data[i] = field.To(field.Residue(source[i].Value()));
+            } else {
+                uint32_t down = source[i].DenominatorResidue(field.Mod());
+                if (down == 0) {
+                    return std::nullopt;
+                }
+                uint32_t up = field.To(source[i].NumeratorResidue(field.Mod()));
+                result.data[i] = field.Multiply(up, field.Inverse(field.To(down)));
+            }
+        }
+        return result;
+    }
+
+    // row[j] -= coef * pivot_row[j] for j in [from, to), the loop has no dependencies and vectorizes
+    void EliminateRow(uint32_t* row, const uint32_t* pivot_row, uint32_t coef, size_t from, size_t to,
+                      const Montgomery& field) {
+        for (size_t j = from; j < to; ++j) {
+            row[j] = field.Sub(row[j], field.Multiply(coef, pivot_row[j]));
+        }
+    }
+
+    // Gauss-Jordan over columns [0, pivot_columns), returns the rank and the determinant
+    // (in Montgomery form) of the left square part when it is of full rank
+    std::pair<size_t, uint32_t> Eliminate(ModularMatrix& matrix, size_t pivot_columns, bool reduce_above,
+                                          const Montgomery& field) {
+        size_t rank = 0;
+        uint32_t determinant = field.To(1);
+        for (size_t column = 0; column < pivot_columns && rank < matrix.rows; ++column) {
+            size_t found = rank;
+            while (found < matrix.rows && matrix.data[found * matrix.columns + column] == 0) ++found;
+            if (found == matrix.rows) {
+                determinant = 0;
+                continue;
+            }
+            if (found != rank) {
+                std::swap_ranges(matrix.Row(found), matrix.Row(found) + matrix.columns, matrix.Row(rank));
+                determinant = field.Sub(0, determinant);
+            }
+
+            uint32_t* pivot_row = matrix.Row(rank);
+            determinant = field.Multiply(determinant, pivot_row[column]);
+            uint32_t inverse = field.Inverse(pivot_row[column]);
+            for (size_t j = column; j < matrix.columns; ++j) {
+                pivot_row[j] = field.Multiply(pivot_row[j], inverse);
+            }
+            for (size_t i = reduce_above ? 0 : rank + 1; i < matrix.rows; ++i) {
+                uint32_t* row = matrix.Row(i);
+                if (i == rank || row[column] == 0) continue;
+                EliminateRow(row, pivot_row, row[column], column, matrix.columns, field);
+            }
+            ++rank;
+        }
+        return {rank, determinant};
+    }
+
+    // deterministic Miller-Rabin for 32-bit values
+    bool IsPrime(uint32_t value) {
+        if (value % 2 == 0) {
+            return value == 2;
+        }
+        Montgomery field(value);
+        uint32_t odd = value - 1;
+        int twos = std::countr_zero(odd);
+        odd >>= twos;
+        uint32_t one = field.To(1);
+        uint32_t minus_one = field.To(value - 1);
+        for (uint32_t base : {2, 7, 61}) {
+            if (base % value == 0) {
+                continue;
+            }
+            uint32_t x = field.Power(field.To(base), odd);
+            bool witness = x != one && x != minus_one;
+            for (int i = 1; i < twos && witness; ++i) {
+                x = field.Multiply(x, x);
+                witness = x != minus_one;
+            }
+            if (witness) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    // Distinct random primes in [2^30, 2^31), so products of two residues fit into uint64_t. There are
+    // about 5 * 10^7 of them, so no input can be made to vanish modulo the primes that are picked.
+    class RandomPrimes {
+    public:
+        RandomPrimes()
+            : random_(std::random_device{}())
+        {}
+
+        uint32_t Next() {
+            std::uniform_int_distribution<uint32_t> half(uint32_t{1} << 29, (uint32_t{1} << 30) - 1);
+            while (true) {
+                uint32_t candidate = 2 * half(random_) + 1;
+                if (IsPrime(candidate) && used_.insert(candidate).second) {
+                    return candidate;
+                }
+            }
+        }
+
+    private:
+        std::mt19937 random_;
+        std::unordered_set<uint32_t> used_;
+    };
+
+    // NTT friendly primes c * 2^order + 1 below 2^31 from the largest one, with primitive roots,
+    // until they give that many bits, or all of them
+    std::vector<NttPrime> NttPrimes(size_t order, size_t bits) {
+        std::vector<NttPrime> result;
+        size_t total = 0;
+        for (uint32_t c = (uint32_t{1} << (31 - order)) - 1; c > 0 && total < bits; --c) {
+            uint32_t prime = (c << order) + 1;
+            if (!IsPrime(prime)) {
+                continue;
+            }
+            std::vector<uint32_t> factors = {2};
+            uint32_t rest = c;
+            for (uint32_t q = 2; q * q <= rest; ++q) {
+                if (rest % q == 0) {
+                    factors.push_back(q);
+                    while (rest % q == 0) rest /= q;
+                }
+            }
+            if (rest > 1) {
+                factors.push_back(rest);
+            }
+            Montgomery field(prime);
+            uint32_t one = field.To(1);
+            uint32_t generator = 2;
+            while (std::any_of(factors.begin(), factors.end(), [&] (uint32_t q) {
+                return field.Power(field.To(generator), (prime - 1) / q) == one;
+            })) {
+                ++generator;
+            }
+            result.push_back({prime, generator});
+            total += std::bit_width(prime) - 1;
+        }
+        return result;
+    }
+
+    size_t BitWidth(const BigInt& value) {
+        auto limbs = value.Magnitude();
+        return limbs.empty() ? 0 : limbs.size() * 64 - std::countl_zero(limbs.back());
+    }
+
+    BigInt PowerOfTwo(size_t exponent) {
+        std::vector<uint64_t> limbs(exponent / 64 + 1, 0);
+        limbs.back() = uint64_t{1} << (exponent % 64);
+        return BigInt::FromMagnitude(limbs, false);
+    }
+
+    // bits of the absolute numerator and ceil(log2) of the denominator
+    std::pair<size_t, size_t> ElementBits(const CheckedInt& value) {
+        int64_t x = value.Value();
+        return {std::bit_width(x < 0 ? 0 - static_cast<uint64_t>(x) : static_cast<uint64_t>(x)), 0};
+    }
+
+    std::pair<size_t, size_t> ElementBits(const Fraction& value) {
+        if (!value.IsSmall()) {
+            return {BitWidth(value.BigNumerator()), BitWidth(value.BigDenominator())};
+        }
+        int64_t up = value.Numerator();
+        auto down = static_cast<uint64_t>(value.Denominator());
+        return {std::bit_width(up < 0 ? 0 - static_cast<uint64_t>(up) : static_cast<uint64_t>(up)), std::bit_width(down - 1)};
+    }
+
+    // Sizes in bits for answers made of minors. Every row scaled to integers by the product of its
+    // denominators has the norm at most 2^(numerator + denominators + log2(columns) / 2), so Hadamard's
+    // bound on any minor of the scaled matrix is the sum of those, and the scales are at most 2^denominators.
+    struct MinorBounds {
+        size_t hadamard = 0;
+        size_t denominators = 0;
+        size_t max_row_denominators = 0;
+    };
+
+    template <Scalar T>
+    MinorBounds BoundMinors(const Matrix<T>& matrix) {
+        MinorBounds result;
+        size_t norm = (std::bit_width(matrix.Columns()) + 1) / 2;
+        for (size_t i = 0; i < matrix.Rows(); ++i) {
+            size_t numerator = 0;
+            size_t denominators = 0;
+            for (const auto& element : matrix.Row(i)) {
+                auto [up, down] = ElementBits(element);
+                numerator = std::max(numerator, up);
+                denominators += down;
+            }
+            result.hadamard += numerator + denominators + norm;
+            result.denominators += denominators;
+            result.max_row_denominators = std::max(result.max_row_denominators, denominators);
+        }
+        return result;
+    }
+
+    // sizes of the numerators and the denominators of an answer, in bits
+    struct AnswerBits {
+        size_t numerator = 0;
+        size_t denominator = 0;
+
+        // primes past that many bits cover the answer
+        size_t Covering() const {
+            return numerator + denominator + 2;
+        }
+    };
+
+    // Sizes of the coefficients of a poly determinant. Every row is scaled to integers by the product of
+    // the denominators of its coefficients. The sum of absolute coefficients of a product is at most the
+    // product of those sums, so any coefficient of the scaled determinant is at most the product over
+    // the rows of their sums of absolute coefficients.
+    AnswerBits BoundPolyDeterminant(const Matrix<Poly>& matrix) {
+        AnswerBits result;
+        for (size_t i = 0; i < matrix.Rows(); ++i) {
+            size_t numerator = 0;
+            size_t denominators = 0;
+            size_t terms = 0;
+            for (const auto& element : matrix.Row(i)) {
+                for (const auto& [exponent, coefficient] : element.Terms()) {
+                    auto [up, down] = ElementBits(coefficient);
+                    numerator = std::max(numerator, up);
+                    denominators += down;
+                    ++terms;
+                }
+            }
+            result.numerator += numerator + denominators + std::bit_width(terms);
+            result.denominator += denominators;
+        }
+        return result;
+    }
+
+    // Sizes of the values of a poly at points. The value at u/v times v^d and the product of the
+    // denominators of the coefficients is a sum of d + 1 products of a scaled coefficient and d factors
+    // of at most max(|u|, v).
+    AnswerBits BoundValues(const std::vector<std::pair<uint64_t, Fraction>>& terms, std::span<const Fraction> points) {
+        size_t numerator = 0;
+        size_t denominators = 0;
+        for (const auto& [exponent, coefficient] : terms) {
+            auto [up, down] = ElementBits(coefficient);
+            numerator = std::max(numerator, up);
+            denominators += down;
+        }
+        size_t point_up = 0;
+        size_t point_down = 0;
+        for (const auto& point : points) {
+            auto [up, down] = ElementBits(point);
+            point_up = std::max(point_up, up);
+            point_down = std::max(point_down, down);
+        }
+        uint64_t degree = terms.back().first;
+        return {numerator + denominators + degree * std::max(point_up, point_down) + std::bit_width(degree + 1),
+                denominators + degree * point_down};
+    }
+
+    // Chinese remainder for a vector of values over a growing set of primes, and Wang's rational
+    // reconstruction of them with arbitrary precision. Until the modulus covers the known sizes
+    // of the answer, numerators and denominators are looked for of equal size.
+    // An answer is taken once the modulus covers its sizes, then it is the only one that fits,
+    // or earlier when EARLY_CONFIRMATIONS primes in a row agree with it, unless the primes are not random.
+    class Reconstructor {
+    public:
+        explicit Reconstructor(size_t size = 1, std::optional<AnswerBits> bits = std::nullopt, bool early = true)
+            : values_(size)
+            , bits_(bits)
+            , early_(early)
+        {}
+
+        // Adds the residues modulo one more prime, true once Answer() is taken as the answer.
+        bool Add(std::span<const uint32_t> residues, uint32_t prime) {
+            auto& pool = ThreadPool::Instance();
+            size_t grain = ThreadPool::Grain(modulus_.Magnitude().size() + 1);
+            std::atomic<bool> congruent = answer_.has_value();
+            if (answer_) {
+                pool.ParallelFor(0, values_.size(), [&] (size_t i) {
+                    uint64_t up = (*answer_)[i].NumeratorResidue(prime);
+                    uint64_t down = (*answer_)[i].DenominatorResidue(prime);
+                    if (down == 0 || residues[i] * down % prime != up) {
+                        congruent = false;
+                    }
+                }, grain);
+            }
+
+            if (modulus_.IsZero()) {
+                for (size_t i = 0; i < values_.size(); ++i) {
+                    values_[i] = residues[i];
+                }
+                modulus_ = prime;
+            } else {
+                // value + modulus * k = residue (mod prime)
+                Montgomery field(prime);
+                uint64_t modulus_inverse = field.From(field.Inverse(field.To(modulus_.Residue(prime))));
+                pool.ParallelFor(0, values_.size(), [&] (size_t i) {
+                    uint64_t difference = (residues[i] + prime - values_[i].Residue(prime)) % prime;
+                    uint64_t k = difference * modulus_inverse % prime;
+                    if (k != 0) {
+                        values_[i] += modulus_ * BigInt(static_cast<int64_t>(k));
+                    }
+                }, grain);
+                modulus_ *= BigInt(prime);
+            }
+            // |up| <= up_bound_, down <= down_bound_ with 2 * up_bound_ * down_bound_ <= modulus
+            // keeps the reconstruction unique
+            size_t bits = BitWidth(modulus_) - 2;
+            bool covered = bits_ && bits >= bits_->numerator + bits_->denominator;
+            if (covered) {
+                up_bound_ = PowerOfTwo(bits_->numerator);
+                down_bound_ = PowerOfTwo(bits - bits_->numerator);
+            } else {
+                up_bound_ = PowerOfTwo(bits / 2);
+                down_bound_ = up_bound_;
+            }
+
+            if (covered) {
+                answer_ = Rationals();
+                return answer_.has_value();
+            }
+            if (congruent) {
+                return early_ && ++confirmations_ == EARLY_CONFIRMATIONS;
+            }
+            confirmations_ = 0;
+            answer_ = Rationals();
+            return false;
+        }
+
+        const std::vector<Fraction>& Answer() const {
+            return *answer_;
+        }
+
+    private:
+        // up/down with |up| <= up_bound_, down <= down_bound_ and up = down * value (mod modulus)
+        std::optional<Fraction> Rational(const BigInt& value) const {
+            if (value <= up_bound_) {
+                return Fraction(value, BigInt(1));
+            }
+            BigInt negative = modulus_ - value;
+            if (negative <= up_bound_) {
+                return Fraction(-std::move(negative), BigInt(1));
+            }
+            BigInt r0 = modulus_;
+            BigInt r1 = value;
+            BigInt t0 = 0;
+            BigInt t1 = 1;
+            while (r1 > up_bound_) {
+                auto [q, r2] = DivideWithRemainder(r0, r1);
+                BigInt t2 = t0 - q * t1;
+                r0 = std::move(r1);
+                r1 = std::move(r2);
+                t0 = std::move(t1);
+                t1 = std::move(t2);
+            }
+            bool negative_down = t1.IsNegative();
+            BigInt down = negative_down ? -std::move(t1) : std::move(t1);
+            if (down.IsZero() || down > down_bound_) {
+                return std::nullopt;
+            }
+            Fraction result(negative_down ? -std::move(r1) : std::move(r1), down);
+            // gcd(r1, t1) != 1 means there is no fraction with that residue in the bounds
+            if (result.BigDenominator() != down) {
+                return std::nullopt;
+            }
+            return result;
+        }
+
+        // up/down if value * down is small, values with a common denominator skip the Euclid
+        std::optional<Fraction> Rational(const BigInt& value, const BigInt& down) const {
+            BigInt up = DivideWithRemainder(value * down, modulus_).second;
+            if (up <= up_bound_) {
+                return Fraction(std::move(up), down);
+            }
+            up = modulus_ - up;
+            if (up <= up_bound_) {
+                return Fraction(-std::move(up), down);
+            }
+            return Rational(value);
+        }
+
+        // all the values or nullopt, the one that failed last time is tried first, so most of the
+        // calls before the modulus is large enough take one reconstruction
+        std::optional<std::vector<Fraction>> Rationals() {
+            auto first = Rational(values_[failed_]);
+            if (!first) {
+                return std::nullopt;
+            }
+            BigInt down = first->BigDenominator();
+            std::vector<std::optional<Fraction>> results(values_.size());
+            std::atomic<size_t> failed = values_.size();
+            ThreadPool::Instance().ParallelFor(0, values_.size(), [&] (size_t i) {
+                if (failed.load(std::memory_order_relaxed) == values_.size()) {
+                    results[i] = down == BigInt(1) ? Rational(values_[i]) : Rational(values_[i], down);
+                    if (!results[i]) {
+                        failed = i;
+                    }
+                }
+            }, ThreadPool::Grain(modulus_.Magnitude().size() * modulus_.Magnitude().size()));
+            if (failed != values_.size()) {
+                failed_ = failed;
+                return std::nullopt;
+            }
+            std::vector<Fraction> answer;
+            answer.reserve(values_.size());
+            for (auto& result : results) {
+                answer.push_back(std::move(*result));
+            }
+            return answer;
+        }
+
+    private:
+        // values in [0, modulus)
+        BigInt modulus_;
+        BigInt up_bound_;
+        BigInt down_bound_;
+        std::vector<BigInt> values_;
+        std::optional<std::vector<Fraction>> answer_;
+        size_t failed_ = 0;
+        size_t confirmations_ = 0;
+        std::optional<AnswerBits> bits_;
+        bool early_;
+    };
+
+    // dense residues in Montgomery form, nullopt if the prime divides a denominator or the leading coefficient
+    std::optional<std::vector<uint32_t>> ReducePoly(const std::vector<std::pair<uint64_t, Fraction>>& terms,
+                                                    const Montgomery& field) {
+        std::vector<uint32_t> result(terms.back().first + 1, 0);
+        for (const auto& [i, coefficient] : terms) {
+            uint32_t down = coefficient.DenominatorResidue(field.Mod());
+            if (down == 0) {
+                return std::nullopt;
+            }
+            uint32_t up = field.To(coefficient.NumeratorResidue(field.Mod()));
+            result[i] = field.Multiply(up, field.Inverse(field.To(down)));
+        }
+        if (result.back() == 0) {
+            return std::nullopt;
+        }
+        return result;
+    }
+
+    // monic gcd by Euclid, returned as plain residues
+    std::vector<uint32_t> GcdModulo(std::vector<uint32_t> lhs, std::vector<uint32_t> rhs, const Montgomery& field) {
+        while (!rhs.empty()) {
+            uint32_t inverse = field.Inverse(rhs.back());
+            while (lhs.size() >= rhs.size()) {
+                uint32_t factor = field.Multiply(lhs.back(), inverse);
+                size_t shift = lhs.size() - rhs.size();
+                for (size_t i = 0; i < rhs.size(); ++i) {
+                    lhs[shift + i] = field.Sub(lhs[shift + i], field.Multiply(factor, rhs[i]));
+                }
+                while (!lhs.empty() && lhs.back() == 0) {
+                    lhs.pop_back();
+                }
+            }
+            std::swap(lhs, rhs);
+        }
+        uint32_t inverse = field.Inverse(lhs.back());
+        for (auto& value : lhs) {
+            value = field.From(field.Multiply(value, inverse));
+        }
+        return lhs;
+    }
+
+    // det(xI - A) by similarity reduction to upper Hessenberg form, plain residues by growing exponent
+    std::vector<uint32_t> CharacteristicModulo(ModularMatrix& matrix, const Montgomery& field) {
+        size_t N = matrix.rows;
+        for (size_t j = 0; j + 2 < N; ++j) {
+            size_t pivot = j + 1;
+            while (pivot < N && matrix.Row(pivot)[j] == 0) ++pivot;
+            if (pivot == N) {
+                continue;
+            }
+            if (pivot != j + 1) {
+                std::swap_ranges(matrix.Row(pivot), matrix.Row(pivot) + N, matrix.Row(j + 1));
+                for (size_t i = 0; i < N; ++i) {
+                    std::swap(matrix.Row(i)[pivot], matrix.Row(i)[j + 1]);
+                }
+            }
+            uint32_t inverse = field.Inverse(matrix.Row(j + 1)[j]);
+            for (size_t i = j + 2; i < N; ++i) {
+                if (matrix.Row(i)[j] == 0) continue;
+                uint32_t factor = field.Multiply(matrix.Row(i)[j], inverse);
+                EliminateRow(matrix.Row(i), matrix.Row(j + 1), factor, j, N, field);
+                for (size_t k = 0; k < N; ++k) {
+                    matrix.Row(k)[j + 1] = field.Add(matrix.Row(k)[j + 1], field.Multiply(factor, matrix.Row(k)[i]));
+                }
+            }
+        }
+
+        std::vector<std::vector<uint32_t>> polys(N + 1);
+        polys[0] = {field.To(1)};
+        for (size_t k = 0; k < N; ++k) {
+            auto& current = polys[k + 1];
+            current.assign(k + 2, 0);
+            for (size_t d = 0; d <= k; ++d) {
+                current[d + 1] = field.Add(current[d + 1], polys[k][d]);
+                current[d] = field.Sub(current[d], field.Multiply(matrix.Row(k)[k], polys[k][d]));
+            }
+            uint32_t product = field.To(1);
+            for (size_t i = k; i-- > 0 && product != 0;) {
+                product = field.Multiply(product, matrix.Row(i + 1)[i]);
+                uint32_t factor = field.Multiply(matrix.Row(i)[k], product);
+                for (size_t d = 0; d <= i; ++d) {
+                    current[d] = field.Sub(current[d], field.Multiply(factor, polys[i][d]));
+                }
+            }
+        }
+        for (auto& value : polys[N]) {
+            value = field.From(value);
+        }
+        return std::move(polys[N]);
+    }
+
+    // terms of the poly with residues in Montgomery form, nullopt if the prime divides a denominator
+    std::optional<std::vector<std::pair<uint64_t, uint32_t>>> ReduceTerms(const Poly& poly, const Montgomery& field) {
+        std::vector<std::pair<uint64_t, uint32_t>> result;
+        for (const auto& [i, coefficient] : poly.Terms()) {
+            uint32_t down = coefficient.DenominatorResidue(field.Mod());
+            if (down == 0) {
+                return std::nullopt;
+            }
+            uint32_t up = field.To(coefficient.NumeratorResidue(field.Mod()));
+            result.emplace_back(i, field.Multiply(up, field.Inverse(field.To(down))));
+        }
+        return result;
+    }
+
+    // coefficients (plain residues) of the poly of degree < values.size() taking values[i] at x = i,
+    // by Newton's divided differences, the nodes are j apart at level j
+    std::vector<uint32_t> Interpolate(std::vector<uint32_t> values, const Montgomery& field) {
+        size_t points = values.size();
+        for (size_t level = 1; level < points; ++level) {
+            uint32_t inverse = field.Inverse(field.To(static_cast<uint32_t>(level)));
+            for (size_t i = points - 1; i >= level; --i) {
+                values[i] = field.Multiply(field.Sub(values[i], values[i - 1]), inverse);
+            }
+        }
+        std::vector<uint32_t> result = {values.back()};
+        for (size_t i = points - 1; i-- > 0;) {
+            // result = result * (x - i) + values[i]
+            uint32_t node = field.To(static_cast<uint32_t>(i));
+            result.push_back(0);
+            for (size_t k = result.size() - 1; k > 0; --k) {
+                result[k] = field.Sub(result[k - 1], field.Multiply(node, result[k]));
+            }
+            result[0] = field.Sub(values[i], field.Multiply(node, result[0]));
+        }
+        for (auto& value : result) {
+            value = field.From(value);
+        }
+        return result;
+    }
+
+    // residue in Montgomery form, nullopt if the prime divides the denominator
+    std::optional<uint32_t> ReduceFraction(const Fraction& value, const Montgomery& field) {
+        uint32_t down = value.DenominatorResidue(field.Mod());
+        if (down == 0) {
+            return std::nullopt;
+        }
+        uint32_t up = field.To(value.NumeratorResidue(field.Mod()));
+        return field.Multiply(up, field.Inverse(field.To(down)));
+    }
+
+    // inverse power series of values modulo x^length by Newton's iteration, values[0] != 0
+    std::vector<uint32_t> InverseSeries(std::span<const uint32_t> values, size_t length, const NttPrime& prime,
+                                        const Montgomery& field) {
+        std::vector<uint32_t> result = {field.Inverse(values[0])};
+        while (result.size() < length) {
+            size_t current = std::min(2 * result.size(), length);
+            // result = result * (2 - values * result) mod x^current
+            auto correction = MultiplyModulo(values.first(std::min(current, values.size())), result, prime);
+            correction.resize(current);
+            for (auto& value : correction) {
+                value = field.Sub(0, value);
+            }
+            correction[0] = field.Add(correction[0], field.To(2));
+            result = MultiplyModulo(result, correction, prime);
+            result.resize(current);
+        }
+        return result;
+    }
+
+    // dividend mod divisor, long quotients are found from the reversed polys by an inverse power series
+    std::vector<uint32_t> RemainderModulo(std::vector<uint32_t> dividend, std::span<const uint32_t> divisor,
+                                          const NttPrime& prime, const Montgomery& field) {
+        if (dividend.size() < divisor.size()) {
+            return dividend;
+        }
+        size_t quotient_length = dividend.size() - divisor.size() + 1;
+        if (std::min(quotient_length, divisor.size()) < NTT_MIN_LENGTH) {
+            uint32_t inverse = field.Inverse(divisor.back());
+            for (size_t shift = quotient_length; shift-- > 0;) {
+                uint32_t factor = field.Multiply(dividend[shift + divisor.size() - 1], inverse);
+                for (size_t i = 0; i < divisor.size(); ++i) {
+                    dividend[shift + i] = field.Sub(dividend[shift + i], field.Multiply(factor, divisor[i]));
+                }
+            }
+        } else {
+            std::vector<uint32_t> reversed(divisor.rbegin(), divisor.rend());
+            auto inverse = InverseSeries(reversed, quotient_length, prime, field);
+            std::vector<uint32_t> quotient(dividend.rbegin(), dividend.rbegin() + quotient_length);
+            quotient = MultiplyModulo(quotient, inverse, prime);
+            quotient.resize(quotient_length);
+            std::reverse(quotient.begin(), quotient.end());
+            auto product = MultiplyModulo(quotient, divisor, prime);
+            for (size_t i = 0; i + 1 < divisor.size(); ++i) {
+                dividend[i] = field.Sub(dividend[i], product[i]);
+            }
+        }
+        dividend.resize(divisor.size() - 1);
+        return dividend;
+    }
+
+    // Plain values at the points by remainders down a subproduct tree, O(M(n) log n) for n points.
+    // The lowest level holds products of x - point over blocks of MULTIPOINT_LEAF_POINTS points,
+    // every next one multiplies pairs of nodes of the previous level.
+    std::vector<uint32_t> EvaluateModulo(std::vector<uint32_t> poly, const std::vector<uint32_t>& points,
+                                         const NttPrime& prime, const Montgomery& field) {
+        std::vector<std::vector<std::vector<uint32_t>>> tree(1);
+        for (size_t begin = 0; begin < points.size(); begin += MULTIPOINT_LEAF_POINTS) {
+            std::vector<uint32_t> product = {field.To(1)};
+            for (size_t i = begin; i < std::min(begin + MULTIPOINT_LEAF_POINTS, points.size()); ++i) {
+                product.push_back(0);
+                for (size_t k = product.size() - 1; k > 0; --k) {
+                    product[k] = field.Sub(product[k - 1], field.Multiply(points[i], product[k]));
+                }
+                product[0] = field.Sub(0, field.Multiply(points[i], product[0]));
+            }
+            tree[0].push_back(std::move(product));
+        }
+        while (tree.back().size() > 1) {
+            std::vector<std::vector<uint32_t>> next;
+            const auto& level = tree.back();
+            for (size_t i = 0; i < level.size(); i += 2) {
+                next.push_back(i + 1 < level.size() ? MultiplyModulo(level[i], level[i + 1], prime) : level[i]);
+            }
+            tree.push_back(std::move(next));
+        }
+
+        std::vector<std::vector<uint32_t>> remainders;
+        remainders.push_back(RemainderModulo(std::move(poly), tree.back()[0], prime, field));
+        for (size_t level = tree.size() - 1; level-- > 0;) {
+            std::vector<std::vector<uint32_t>> next;
+            for (size_t i = 0; i < tree[level].size(); ++i) {
+                next.push_back(RemainderModulo(remainders[i / 2], tree[level][i], prime, field));
+            }
+            remainders = std::move(next);
+        }
+
+        std::vector<uint32_t> values(points.size());
+        for (size_t block = 0; block < remainders.size(); ++block) {
+            const auto& remainder = remainders[block];
+            size_t end = std::min((block + 1) * MULTIPOINT_LEAF_POINTS, points.size());
+            for (size_t i = block * MULTIPOINT_LEAF_POINTS; i < end; ++i) {
+                uint32_t value = 0;
+                for (size_t k = remainder.size(); k-- > 0;) {
+                    value = field.Add(field.Multiply(value, points[i]), remainder[k]);
+                }
+                values[i] = field.From(value);
+            }
+        }
+        return values;
+    }
+
+    // coefficients by growing exponent
+    Poly ToPoly(const std::vector<Fraction>& coefficients) {
+        std::vector<std::pair<uint64_t, Fraction>> terms;
+        for (size_t i = 0; i < coefficients.size(); ++i) {
+            if (!coefficients[i].IsZero()) {
+                terms.emplace_back(i, coefficients[i]);
+            }
+        }
+        return Poly(std::move(terms));
+    }
+
+    // Runs compute(prime) for primes in batches, each batch in parallel, and feeds results
+    // to accept until it reports that the answer is stable. Primes for which compute returns
+    // nullopt are skipped. Returns false once the good primes multiply to more than 2^max_bits,
+    // or the given primes run out, without a stable answer. The default primes are RandomPrimes.
+    template <typename Result, typename Compute, typename Accept>
+    bool ForPrimes(Compute compute, Accept accept, size_t max_bits, std::span<const uint32_t> primes = {}) {
+        RandomPrimes random;
+        const auto prime_at = [&] (size_t i) {
+            return primes.empty() ? random.Next() : primes[i];
+        };
+        size_t limit = primes.empty() ? std::numeric_limits<size_t>::max() : primes.size();
+        size_t bits = 0;
+        size_t next = 0;
+        while (bits <= max_bits && next < limit) {
+            size_t batch = std::min(next == 0 ? FIRST_BATCH : ThreadPool::Instance().Size(), limit - next);
+            std::vector<uint32_t> batch_primes;
+            for (size_t i = 0; i < batch; ++i) {
+                batch_primes.push_back(prime_at(next + i));
+            }
+            std::vector<std::optional<Result>> results(batch);
+            std::vector<std::function<void()>> tasks;
+            for (size_t i = 0; i < batch; ++i) {
+                tasks.emplace_back([&, i] { results[i] = compute(batch_primes[i]); });
+            }
+            ThreadPool::Instance().Run(tasks);
+            for (size_t i = 0; i < batch && bits <= max_bits; ++i) {
+                if (!results[i]) continue;
+                bits += std::bit_width(batch_primes[i]) - 1;
+                if (accept(*results[i], batch_primes[i])) {
+                    return true;
+                }
+            }
+            next += batch;
+        }
+        return false;
+    }
+}
+
+template <Scalar T>
+    requires std::same_as<T, CheckedInt> || std::same_as<T, Fraction>
+std::optional<Fraction> ModularDeterminant(const Matrix<T>& matrix) {
+    if (!matrix.IsSquare()) {
+        throw MatrixException("Try to find determinant of non square matrix");
+    }
+
+    // the determinant of the scaled rows is a minor, the scales give its denominator
+    auto bounds = BoundMinors(matrix);
+    AnswerBits bits{bounds.hadamard, bounds.denominators};
+    Reconstructor reconstructor(1, bits);
+    bool stable = ForPrimes<uint32_t>(
+        [&] (uint32_t prime) -> std::optional<uint32_t> {
+            Montgomery field(prime);
+            auto reduced = Reduce(matrix, field);
+            if (!reduced) {
+                return std::nullopt;
+            }
+            return field.From(Eliminate(*reduced, reduced->columns, false, field).second);
+        },
+        [&] (uint32_t residue, uint32_t prime) {
+            return reconstructor.Add(std::span(&residue, 1), prime);
+        },
+        bits.Covering());
+    return stable ? std::optional<Fraction>(reconstructor.Answer()[0]) : std::nullopt;
+}
+
+template <Scalar T>
+    requires std::same_as<T, CheckedInt> || std::same_as<T, Fraction>
+std::optional<Matrix<Fraction>> ModularInverse(const Matrix<T>& matrix) {
+    if (!matrix.IsSquare()) {
+        throw MatrixException("Try to invert non square matrix");
+    }
+
+    // elements are cofactors of the scaled rows times a scale over their determinant
+    size_t N = matrix.Rows();
+    auto bounds = BoundMinors(matrix);
+    AnswerBits bits{bounds.hadamard + bounds.max_row_denominators, bounds.hadamard};
+    Reconstructor reconstructor(N * N, bits);
+    bool stable = ForPrimes<std::vector<uint32_t>>(
+        [&] (uint32_t prime) -> std::optional<std::vector<uint32_t>> {
+            Montgomery field(prime);
+            auto reduced = Reduce(matrix, field);
+            if (!reduced) {
+                return std::nullopt;
+            }
+            ModularMatrix extended{N, 2 * N, std::vector<uint32_t>(2 * N * N)};
+            for (size_t i = 0; i < N; ++i) {
+                std::copy(reduced->Row(i), reduced->Row(i) + N, extended.Row(i));
+                extended.Row(i)[N + i] = field.To(1);
+            }
+            if (Eliminate(extended, N, true, field).first != N) {
+                // singular modulo this prime, maybe singular at all, exact elimination decides
+                return std::nullopt;
+            }
+            std::vector<uint32_t> inverse(N * N);
+            for (size_t i = 0; i < N; ++i) {
+                for (size_t j = 0; j < N; ++j) {
+                    inverse[i * N + j] = field.From(extended.Row(i)[N + j]);
+                }
+            }
+            return inverse;
+        },
+        [&] (const std::vector<uint32_t>& residues, uint32_t prime) {
+            return reconstructor.Add(residues, prime);
+        },
+        bits.Covering());
+    if (!stable) {
+        return std::nullopt;
+    }
+    Matrix<Fraction> result(N);
+    for (size_t i = 0; i < N * N; ++i) {
+        result(i / N, i % N) = reconstructor.Answer()[i];
+    }
+    return result;
+}
+
+template <Scalar T>
+    requires std::same_as<T, CheckedInt> || std::same_as<T, Fraction>
+std::optional<size_t> ModularRank(const Matrix<T>& matrix) {
+    size_t full = std::min(matrix.Rows(), matrix.Columns());
+    size_t rank = 0;
+    size_t computed = 0;
+    ForPrimes<size_t>(
+        [&] (uint32_t prime) -> std::optional<size_t> {
+            Montgomery field(prime);
+            auto reduced = Reduce(matrix, field);
+            if (!reduced) {
+                return std::nullopt;
+            }
+            return Eliminate(*reduced, reduced->columns, false, field).first;
+        },
+        [&] (size_t current, uint32_t) {
+            rank = std::max(rank, current);
+            return rank == full || ++computed == RANK_PRIMES;
+        },
+        std::numeric_limits<size_t>::max());
+    // a nonzero minor modulo a prime is nonzero, so only the full rank is certain
+    return rank == full ? std::optional<size_t>(rank) : std::nullopt;
+}
+
+std::optional<Poly> ModularPolyDeterminant(const Matrix<Poly>& matrix) {
+    if (!matrix.IsSquare()) {
+        throw MatrixException("Try to find determinant of non square matrix");
+    }
+
+    // the determinant degree is bounded by the sums of row and of column degrees
+    size_t N = matrix.Rows();
+    uint64_t row_bound = 0;
+    std::vector<uint64_t> column_degrees(N, 0);
+    for (size_t i = 0; i < N; ++i) {
+        uint64_t row_degree = 0;
+        for (size_t j = 0; j < N; ++j) {
+            // keeps the sums below from wrapping around
+            if (matrix(i, j).Degree() > MODULAR_POLY_MAX_DEGREE) {
+                return std::nullopt;
+            }
+            row_degree = std::max(row_degree, matrix(i, j).Degree());
+            column_degrees[j] = std::max(column_degrees[j], matrix(i, j).Degree());
+        }
+        row_bound += row_degree;
+    }
+    uint64_t column_bound = std::accumulate(column_degrees.begin(), column_degrees.end(), uint64_t{0});
+    uint64_t degree = std::min(row_bound, column_bound);
+    if (degree > MODULAR_POLY_MAX_DEGREE) {
+        return std::nullopt;
+    }
+    size_t points = degree + 1;
+
+    // every exponent of the answer is a sum of exponents taken one from each row, when there are
+    // few such sums the answer is sparse and most of the points would be wasted
+    std::vector<uint64_t> sums = {0};
+    for (size_t i = 0; i < N && sums.size() * SPARSE_FILL_FACTOR <= points; ++i) {
+        std::vector<uint64_t> exponents;
+        for (size_t j = 0; j < N; ++j) {
+            for (const auto& [exponent, coefficient] : matrix(i, j).Terms()) {
+                exponents.push_back(exponent);
+            }
+        }
+        std::sort(exponents.begin(), exponents.end());
+        exponents.erase(std::unique(exponents.begin(), exponents.end()), exponents.end());
+        std::vector<uint64_t> next;
+        next.reserve(sums.size() * exponents.size());
+        for (uint64_t sum : sums) {
+            for (uint64_t exponent : exponents) {
+                next.push_back(sum + exponent);
+            }
+        }
+        std::sort(next.begin(), next.end());
+        next.erase(std::unique(next.begin(), next.end()), next.end());
+        sums = std::move(next);
+    }
+    if (sums.size() * SPARSE_FILL_FACTOR <= points) {
+        return std::nullopt;
+    }
+
+    auto bits = BoundPolyDeterminant(matrix);
+    Reconstructor reconstructor(points, bits);
+    bool stable = ForPrimes<std::vector<uint32_t>>(
+        [&] (uint32_t prime) -> std::optional<std::vector<uint32_t>> {
+            Montgomery field(prime);
+            std::vector<std::vector<std::pair<uint64_t, uint32_t>>> elements;
+            elements.reserve(N * N);
+            for (const auto& element : matrix.Data()) {
+                auto reduced = ReduceTerms(element, field);
+                if (!reduced) {
+                    return std::nullopt;
+                }
+                elements.push_back(std::move(*reduced));
+            }
+
+            std::vector<uint32_t> values(points);
+            ThreadPool::Instance().ParallelFor(0, points, [&] (size_t point) {
+                uint32_t x = field.To(static_cast<uint32_t>(point));
+                ModularMatrix evaluated{N, N, std::vector<uint32_t>(N * N)};
+                for (size_t id = 0; id < N * N; ++id) {
+                    uint32_t value = 0;
+                    uint32_t power = field.To(1);
+                    uint64_t exponent = 0;
+                    for (const auto& [i, coefficient] : elements[id]) {
+                        power = field.Multiply(power, field.Power(x, i - exponent));
+                        exponent = i;
+                        value = field.Add(value, field.Multiply(coefficient, power));
+                    }
+                    evaluated.data[id] = value;
+                }
+                values[point] = Eliminate(evaluated, N, false, field).second;
+            }, ThreadPool::Grain(N * N * N));
+            return Interpolate(std::move(values), field);
+        },
+        [&] (const std::vector<uint32_t>& coefficients, uint32_t prime) {
+            return reconstructor.Add(coefficients, prime);
+        },
+        bits.Covering());
+    return stable ? std::optional<Poly>(ToPoly(reconstructor.Answer())) : std::nullopt;
+}
+
+// a prime giving a higher degree is unlucky and skipped, a lower degree restarts the reconstruction
+std::optional<Poly> ModularGcd(const Poly& lhs, const Poly& rhs) {
+    if (std::max(lhs.Degree(), rhs.Degree()) > MODULAR_POLY_MAX_DEGREE) {
+        return std::nullopt;
+    }
+    auto lhs_terms = lhs.Terms();
+    auto rhs_terms = rhs.Terms();
+
+    size_t degree = std::numeric_limits<size_t>::max();
+    Reconstructor reconstructor;
+    std::optional<Poly> result;
+    bool stable = ForPrimes<std::vector<uint32_t>>(
+        [&] (uint32_t prime) -> std::optional<std::vector<uint32_t>> {
+            Montgomery field(prime);
+            auto lhs_residues = ReducePoly(lhs_terms, field);
+            auto rhs_residues = ReducePoly(rhs_terms, field);
+            if (!lhs_residues || !rhs_residues) {
+                return std::nullopt;
+            }
+            return GcdModulo(std::move(*lhs_residues), std::move(*rhs_residues), field);
+        },
+        [&] (const std::vector<uint32_t>& residues, uint32_t prime) {
+            if (residues.size() - 1 > degree) {
+                return false;
+            }
+            if (residues.size() - 1 < degree) {
+                degree = residues.size() - 1;
+                reconstructor = Reconstructor(residues.size());
+            }
+            if (!reconstructor.Add(residues, prime)) {
+                return false;
+            }
+            result = ToPoly(reconstructor.Answer());
+            return DivideWithRemainder(lhs, *result).second.IsZero() && DivideWithRemainder(rhs, *result).second.IsZero();
+        },
+        UNBOUNDED_MAX_BITS);
+    return stable ? result : std::nullopt;
+}
+
+template <Scalar T>
+    requires std::same_as<T, CheckedInt> || std::same_as<T, Fraction>
+std::optional<Poly> ModularCharacteristicPolynomial(const Matrix<T>& matrix) {
+    if (!matrix.IsSquare()) {
+        throw MatrixException("Try to find characteristic polynomial of non square matrix");
+    }
+
+    // a coefficient is a sum of at most 2^N principal minors, over the product of all the scales
+    auto bounds = BoundMinors(matrix);
+    AnswerBits bits{matrix.Rows() + bounds.hadamard, bounds.denominators};
+    Reconstructor reconstructor(matrix.Rows() + 1, bits);
+    bool stable = ForPrimes<std::vector<uint32_t>>(
+        [&] (uint32_t prime) -> std::optional<std::vector<uint32_t>> {
+            Montgomery field(prime);
+            auto reduced = Reduce(matrix, field);
+            if (!reduced) {
+                return std::nullopt;
+            }
+            return CharacteristicModulo(*reduced, field);
+        },
+        [&] (const std::vector<uint32_t>& residues, uint32_t prime) {
+            return reconstructor.Add(residues, prime);
+        },
+        bits.Covering());
+    return stable ? std::optional<Poly>(ToPoly(reconstructor.Answer())) : std::nullopt;
+}
+
+std::optional<std::vector<Fraction>> ModularEvaluate(const Poly& poly, std::span<const Fraction> points) {
+    if (poly.IsZero() || points.empty()) {
+        return std::vector<Fraction>(points.size());
+    }
+    if (poly.Degree() > MODULAR_POLY_MAX_DEGREE) {
+        return std::nullopt;
+    }
+    auto terms = poly.Terms();
+    auto bits = BoundValues(terms, points);
+    if (bits.Covering() > MULTIPOINT_MAX_BITS) {
+        return std::nullopt;
+    }
+
+    // the primes are taken in order, so the values are taken only once the primes cover the bound,
+    // and the products down the tree are at most twice as long as the poly or the points
+    size_t order = std::bit_width(2 * (std::max<uint64_t>(poly.Degree(), points.size()) + 1));
+    if (order > 30) {
+        return std::nullopt;
+    }
+    auto ntt_primes = NttPrimes(order, bits.Covering());
+    std::vector<uint32_t> moduli;
+    for (const auto& ntt_prime : ntt_primes) {
+        moduli.push_back(ntt_prime.mod);
+    }
+    Reconstructor reconstructor(points.size(), bits, false);
+    bool stable = ForPrimes<std::vector<uint32_t>>(
+        [&] (uint32_t prime) -> std::optional<std::vector<uint32_t>> {
+            const auto& ntt_prime = *std::find_if(ntt_primes.begin(), ntt_primes.end(),
+                [&] (const NttPrime& candidate) { return candidate.mod == prime; });
+            Montgomery field(prime);
+            auto coefficients = ReducePoly(terms, field);
+            if (!coefficients) {
+                return std::nullopt;
+            }
+            std::vector<uint32_t> residues;
+            residues.reserve(points.size());
+            for (const auto& point : points) {
+                auto residue = ReduceFraction(point, field);
+                if (!residue) {
+                    return std::nullopt;
+                }
+                residues.push_back(*residue);
+            }
+            return EvaluateModulo(std::move(*coefficients), residues, ntt_prime, field);
+        },
+        [&] (const std::vector<uint32_t>& residues, uint32_t prime) {
+            return reconstructor.Add(residues, prime);
+        },
+        bits.Covering(), moduli);
+    return stable ? std::optional<std::vector<Fraction>>(reconstructor.Answer()) : std::nullopt;
+}
+
+template std::optional<Fraction> ModularDeterminant(const Matrix<CheckedInt>& matrix);
+template std::optional<Fraction> ModularDeterminant(const Matrix<Fraction>& matrix);
+template std::optional<Matrix<Fraction>> ModularInverse(const Matrix<CheckedInt>& matrix);
+template std::optional<Matrix<Fraction>> ModularInverse(const Matrix<Fraction>& matrix);
+template std::optional<size_t> ModularRank(const Matrix<CheckedInt>& matrix);
+template std::optional<size_t> ModularRank(const Matrix<Fraction>& matrix);
+template std::optional<Poly> ModularCharacteristicPolynomial(const Matrix<CheckedInt>& matrix);
+template std::optional<Poly> ModularCharacteristicPolynomial(const Matrix<Fraction>& matrix);
@@ -0,0 +1,42 @@
+#pragma once
+
+#include "matrix.h"
+
+#include <optional>
+#include <span>
+#include <vector>
+
+// Exact answers for integer and fraction matrices computed modulo random word-size primes
+// (in parallel) and rebuilt by CRT over long integers and rational reconstruction. Primes
+// are added until their product passes a Hadamard bound on the answer, or until several
+// more primes in a row agree with the reconstructed answer. nullopt means no answer was
+// found within the bound, then exact elimination has to be used.
+
+template <Scalar T>
+    requires std::same_as<T, CheckedInt> || std::same_as<T, Fraction>
+std::optional<Fraction> ModularDeterminant(const Matrix<T>& matrix);
+
+template <Scalar T>
+    requires std::same_as<T, CheckedInt> || std::same_as<T, Fraction>
+std::optional<Matrix<Fraction>> ModularInverse(const Matrix<T>& matrix);
+
+// the rank modulo a prime can only drop, so only the full rank is certain, otherwise nullopt
+template <Scalar T>
+    requires std::same_as<T, CheckedInt> || std::same_as<T, Fraction>
+std::optional<size_t> ModularRank(const Matrix<T>& matrix);
+
+// det(xI - A), every prime reduces the matrix to upper Hessenberg form in O(n^3)
+template <Scalar T>
+    requires std::same_as<T, CheckedInt> || std::same_as<T, Fraction>
+std::optional<Poly> ModularCharacteristicPolynomial(const Matrix<T>& matrix);
+
+// determinant of a poly matrix: the matrix is evaluated at deg + 1 points (in parallel), where deg
+// bounds the degree of the answer, and the numeric determinants are interpolated
+std::optional<Poly> ModularPolyDeterminant(const Matrix<Poly>& matrix);
+
+// monic greatest common divisor of two nonzero polys, checked by exact division
+std::optional<Poly> ModularGcd(const Poly& lhs, const Poly& rhs);
+
+// values of a poly at many points by remainders down a subproduct tree modulo NTT primes, taken once
+// the primes cover the bound on the values, nullopt when that needs too many of them
+std::optional<std::vector<Fraction>> ModularEvaluate(const Poly& poly, std::span<const Fraction> points);
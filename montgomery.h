@@ -0,0 +1,75 @@
+#pragma once
+
+#include <cstdint>
+
+// Montgomery form with R = 2^32, all values are kept in [0, mod)
+class Montgomery {
+public:
+    explicit Montgomery(uint32_t mod)
+        : mod_(mod)
+    {
+        uint32_t inverse = mod;
+        for (int i = 0; i < 5; ++i) {
+            inverse *= 2 - mod * inverse;
+        }
+        negative_inverse_ = -inverse;
+        r2_ = static_cast<uint32_t>((static_cast<unsigned __int128>(1) << 64) % mod);
+    }
+
+    uint32_t Mod() const {
+        return mod_;
+    }
+
+    uint32_t Reduce(uint64_t value) const {
+        uint32_t m = static_cast<uint32_t>(value) * negative_inverse_;
+        uint32_t result = (value + static_cast<uint64_t>(m) * mod_) >> 32;
+        return result >= mod_ ? result - mod_ : result;
+    }
+
+    uint32_t To(uint32_t value) const {
+        return Reduce(static_cast<uint64_t>(value) * r2_);
+    }
+
+    uint32_t From(uint32_t value) const {
+        return Reduce(value);
+    }
+
+    uint32_t Multiply(uint32_t lhs, uint32_t rhs) const {
+        return Reduce(static_cast<uint64_t>(lhs) * rhs);
+    }
+
+    uint32_t Add(uint32_t lhs, uint32_t rhs) const {
+        uint32_t result = lhs + rhs;
+        return result >= mod_ ? result - mod_ : result;
+    }
+
+    uint32_t Sub(uint32_t lhs, uint32_t rhs) const {
+        return lhs >= rhs ? lhs - rhs : lhs + mod_ - rhs;
+    }
+
+    uint32_t Power(uint32_t base, uint64_t power) const {
+        uint32_t result = To(1);
+        for (; power > 0; power >>= 1) {
+            if (power & 1) {
+                result = Multiply(result, base);
+            }
+            base = Multiply(base, base);
+        }
+        return result;
+    }
+
+    uint32_t Inverse(uint32_t value) const {
+        return Power(value, mod_ - 2);
+    }
+
+    // plain (not Montgomery) residue of a signed number
+    uint32_t Residue(int64_t value) const {
+        int64_t result = value % static_cast<int64_t>(mod_);
+        return static_cast<uint32_t>(result < 0 ? result + mod_ : result);
+    }
+
+private:
+    uint32_t mod_;
+    uint32_t negative_inverse_;
+    uint32_t r2_;
+};
@@ -1,181 +1,775 @@
 #include "poly.h"
 
+#include "arena.h"
+#include "modular.h"
+#include "poly_multiply.h"
+#include "thread_pool.h"
+
+#include <algorithm>
+#include <charconv>
+#include <iterator>
 #include <map>
-#include <vector>
+#include <memory_resource>
+#include <mutex>
+#include <span>
+#include <stdexcept>
+#include <unordered_set>
 
 namespace {
-    int64_t BinaryPow(int64_t x, uint64_t power) {
-        if (power == 0) {
-            return 1;
+    // polys of lower degree are always dense
+    constexpr uint64_t DENSE_MIN_DEGREE = 16;
+    // otherwise dense storage is used when at least 1 / DENSE_FILL_FACTOR of coefficients are nonzero
+    constexpr uint64_t DENSE_FILL_FACTOR = 4;
+    // dense polys at least that long are evaluated at batches at least that large by a subproduct tree
+    constexpr uint64_t MULTIPOINT_MIN_DEGREE = 128;
+    constexpr size_t MULTIPOINT_MIN_POINTS = 128;
+    // interned polys are hashed by their coefficients modulo a prime
+    constexpr uint32_t HASH_MOD = 2147483647;
+    constexpr size_t HASH_MULTIPLIER = 1000003;
+
+    bool IsZeroCoefficient(const Fraction& value) {
+        return value.IsZero();
+    }
+
+    bool PreferDense(uint64_t degree, size_t nonzeros) {
+        return degree < DENSE_MIN_DEGREE || degree / DENSE_FILL_FACTOR < nonzeros;
+    }
+
+    using Term = std::pair<uint64_t, Fraction>;
+
+    // Johnson's heap multiplication: the heap holds the next product of every lhs term that has
+    // been reached, so products come out by growing exponent and equal ones are summed right away.
+    // The lhs term i + 1 enters when term i meets rhs[0], the heap never exceeds lhs.size()
+    std::pmr::vector<Term> MultiplyHeap(std::span<const Term> lhs, std::span<const Term> rhs,
+                                        std::pmr::memory_resource* resource) {
+        struct Cursor {
+            uint64_t exponent;
+            size_t lhs_id;
+            size_t rhs_id;
+        };
+        std::pmr::vector<Cursor> heap(resource);
+        heap.reserve(lhs.size());
+
+        // min-heap by exponent, the top is replaced by its successor in place instead of pop and push
+        const auto sift_down = [&] (size_t id) {
+            Cursor moving = heap[id];
+            while (2 * id + 1 < heap.size()) {
+                size_t child = 2 * id + 1;
+                if (child + 1 < heap.size() && heap[child + 1].exponent < heap[child].exponent) {
+                    ++child;
+                }
+                if (moving.exponent <= heap[child].exponent) {
+                    break;
+                }
+                heap[id] = heap[child];
+                id = child;
+            }
+            heap[id] = moving;
+        };
+        const auto push = [&] (Cursor cursor) {
+            size_t id = heap.size();
+            heap.push_back(cursor);
+            while (id > 0 && cursor.exponent < heap[(id - 1) / 2].exponent) {
+                heap[id] = heap[(id - 1) / 2];
+                id = (id - 1) / 2;
+            }
+            heap[id] = cursor;
+        };
+
+        std::pmr::vector<Term> result(resource);
+        push({lhs[0].first + rhs[0].first, 0, 0});
+        while (!heap.empty()) {
+            Cursor cursor = heap.front();
+            Fraction product = lhs[cursor.lhs_id].second * rhs[cursor.rhs_id].second;
+            if (!result.empty() && result.back().first == cursor.exponent) {
+                result.back().second += product;
+            } else {
+                result.emplace_back(cursor.exponent, std::move(product));
+            }
+
+            if (cursor.rhs_id + 1 < rhs.size()) {
+                heap.front() = {lhs[cursor.lhs_id].first + rhs[cursor.rhs_id + 1].first, cursor.lhs_id, cursor.rhs_id + 1};
+            } else {
+                heap.front() = heap.back();
+                heap.pop_back();
+            }
+            if (!heap.empty()) {
+                sift_down(0);
+            }
+            if (cursor.rhs_id == 0 && cursor.lhs_id + 1 < lhs.size()) {
+                push({lhs[cursor.lhs_id + 1].first + rhs[0].first, cursor.lhs_id + 1, 0});
+            }
         }
-        int64_t half = BinaryPow(x, power / 2);
-        return half * half * (power % 2 == 0 ? 1ll : x);
+        return result;
+    }
+
+    Fraction Power(Fraction x, uint64_t power) {
+        Fraction result = 1;
+        for (; power > 0; power >>= 1) {
+            if (power & 1) {
+                result *= x;
+            }
+            if (power > 1) {
+                x *= x;
+            }
+        }
+        return result;
     }
 }
 
+// [+|-]term{(+|-)term}, term is coefficient, [coefficient]x or [coefficient]x^power,
+// coefficient is up[/down], no spaces anywhere
 Poly::Poly(std::string_view str) {
-    std::vector<std::string_view> tokens;
-    size_t id = 0;
-    while (id != std::string::npos) {
-        size_t next_id = std::min(str.find('+', id + 1), str.find('-', id + 1));
-        if (id != 0) {
-            ++id;
+    const char* it = str.data();
+    const char* end = str.data() + str.size();
+    const auto fail = [&] () {
+        throw std::invalid_argument("can't parse poly " + std::string(str) + " at " + std::to_string(it - str.data()));
+    };
+    // plain digits, from_chars alone would also take a sign, false if they don't fit into value
+    const auto number = [&] (auto& value) {
+        if (it == end || *it < '0' || *it > '9') {
+            fail();
         }
-        tokens.push_back(next_id == std::string::npos ? str.substr(id) : str.substr(id, next_id));
-        id = next_id;
+        auto [ptr, error] = std::from_chars(it, end, value);
+        it = ptr;
+        return error != std::errc::result_out_of_range;
+    };
+
+    // the terms are collected right in sparse_, a single one like in most matrix cells stays in place,
+    // a leading sign doesn't start another term
+    sparse_.reserve(std::count_if(it + (it != end), end, [] (char c) { return c == '+' || c == '-'; }) + 1);
+    if (it == end) {
+        fail();
     }
+    for (bool first = true; it != end; first = false) {
+        bool negative = *it == '-';
+        if (*it == '+' || *it == '-') {
+            ++it;
+        } else if (!first) {
+            fail();
+        }
 
-    for (auto token : tokens) {
-        int64_t coef_up = 0;
-        int64_t coef_down = 1;
-        uint64_t power = 0;
-        size_t xId = std::min(token.find('x'), token.size());
-        if (0 == xId) {
-            coef_up = 1;
-        } else {
-            bool is_up = true;
-            bool negative = false;
-            for (size_t id = 0; id < xId; ++id) {
-                if (token[id] == '/') {
-                    is_up = false;
-                    continue;
-                }
-                if (token[id] == '-') {
-                    negative = !negative;
-                    continue;
-                }
-                if (token[id] == '+') {
-                    continue;
-                }
-                if (is_up) {
-                    coef_up = coef_up * 10 + token[id] - '0';
-                } else {
-                    coef_down = coef_down * 10 + token[id] - '0';
-                }
+        Fraction coefficient = 1;
+        bool has_coefficient = it != end && *it != 'x';
+        if (has_coefficient) {
+            const char* begin = it;
+            int64_t up = 0;
+            int64_t down = 1;
+            bool fits = number(up);
+            if (it != end && *it == '/') {
+                ++it;
+                fits &= number(down);
             }
-            if (negative) {
-                coef_up *= -1;
+            if (!fits) {
+                coefficient = Fraction(std::string_view(begin, it));
+            } else if (down == 0) {
+                fail();
+            } else {
+                coefficient = Fraction(negative ? -up : up, down);
+                negative = false;
             }
         }
-        if (xId + 1 == token.size()) {
+        uint64_t power = 0;
+        if (it != end && *it == 'x') {
+            ++it;
             power = 1;
+            if (it != end && *it == '^') {
+                ++it;
+                if (!number(power)) {
+                    throw std::overflow_error("integer overflow");
+                }
+            }
+        } else if (!has_coefficient) {
+            fail();
+        }
+        if (negative) {
+            coefficient = -coefficient;
         }
-        for (size_t id = xId + 2; id < token.size(); ++id) {
-            power = power * 10 + token[id] - '0';
+        if (!coefficient.IsZero()) {
+            sparse_.emplace_back(power, std::move(coefficient));
+        }
+    }
+    SortTerms();
+}
+
+Poly::Poly(const std::initializer_list<Fraction>& coefficients)
+    : dense_(coefficients)
+{
+    Canonicalize();
+}
+
+Poly::Poly(const std::initializer_list<std::pair<uint64_t, Fraction>>& coefficients) {
+    std::vector<Term> terms(coefficients);
+    SetTerms(terms);
+}
+
+Poly::Poly(std::vector<std::pair<uint64_t, Fraction>> terms) {
+    SetTerms(terms);
+}
+
+template <class Function>
+void Poly::ForEachTerm(Function&& function) const {
+    if (IsSparse()) {
+        for (const auto& [i, coefficient] : sparse_) {
+            function(i, coefficient);
         }
-        if (coef_up != 0) {
-            coefficients_[power] += Fraction(coef_up, coef_down);
+    } else {
+        const Fraction* coefficients = dense_.data();
+        for (uint64_t i = 0; i < dense_.size(); ++i) {
+            if (!IsZeroCoefficient(coefficients[i])) {
+                function(i, coefficients[i]);
+            }
         }
     }
 }
 
-Poly::Poly(const std::initializer_list<Fraction>& coefficients) {
-    uint64_t i = 0;
-    for (const auto coefficient : coefficients) {
-        if (coefficient != 0) {
-            coefficients_[i] = coefficient;
+bool Poly::IsSparse() const {
+    return !sparse_.empty();
+}
+
+size_t Poly::NonZeros() const {
+    if (IsSparse()) {
+        return sparse_.size();
+    }
+    return dense_.size() - std::count_if(dense_.begin(), dense_.end(), IsZeroCoefficient);
+}
+
+// terms may be unsorted and contain repeated exponents and zeros, they are moved from
+void Poly::SetTerms(std::span<Term> terms) {
+    sparse_.assign(std::make_move_iterator(terms.begin()), std::make_move_iterator(terms.end()));
+    dense_.clear();
+    SortTerms();
+}
+
+// sorts and merges the terms put into sparse_ while dense_ is empty
+void Poly::SortTerms() {
+    auto& terms = sparse_;
+    const auto by_power = [] (const Term& lhs, const Term& rhs) { return lhs.first < rhs.first; };
+    // written polys usually come in descending order, sorted ones skip the buffer of stable_sort
+    if (std::is_sorted(terms.rbegin(), terms.rend(), by_power)) {
+        std::reverse(terms.begin(), terms.end());
+    } else if (!std::is_sorted(terms.begin(), terms.end(), by_power)) {
+        std::stable_sort(terms.begin(), terms.end(), by_power);
+    }
+    size_t size = 0;
+    for (size_t i = 0; i < terms.size(); ++i) {
+        if (size > 0 && terms[size - 1].first == terms[i].first) {
+            terms[size - 1].second += terms[i].second;
+        } else if (size++ != i) {
+            terms[size - 1] = std::move(terms[i]);
         }
-        ++i;
     }
+    terms.erase(terms.begin() + size, terms.end());
+    Canonicalize();
 }
 
-Poly::Poly(const std::initializer_list<std::pair<uint64_t, Fraction>>& coefficients) {
-    for (const auto& [i, coefficient] : coefficients) {
-        if (coefficient != 0) {
-            coefficients_[i] = coefficient;
+void Poly::MakeDense() {
+    if (!IsSparse()) {
+        return;
+    }
+    dense_.clear();
+    dense_.resize(sparse_.empty() ? 0 : sparse_.back().first + 1);
+    for (auto& [i, coefficient] : sparse_) {
+        dense_[i] = std::move(coefficient);
+    }
+    sparse_.clear();
+}
+
+// drops zero coefficients and picks the storage by density, so equal polys are stored equally
+void Poly::Canonicalize() {
+    if (IsSparse()) {
+        sparse_.erase(std::remove_if(sparse_.begin(), sparse_.end(), [] (const Term& term) {
+            return IsZeroCoefficient(term.second);
+        }), sparse_.end());
+        if (sparse_.empty() || PreferDense(Degree(), sparse_.size())) {
+            MakeDense();
+        }
+        return;
+    }
+    while (!dense_.empty() && IsZeroCoefficient(dense_.back())) {
+        dense_.pop_back();
+    }
+    if (Degree() < DENSE_MIN_DEGREE) {
+        return;
+    }
+    size_t nonzeros = NonZeros();
+    if (!PreferDense(Degree(), nonzeros)) {
+        sparse_.reserve(nonzeros);
+        for (uint64_t i = 0; i < dense_.size(); ++i) {
+            if (!IsZeroCoefficient(dense_[i])) {
+                sparse_.emplace_back(i, std::move(dense_[i]));
+            }
         }
+        dense_.clear();
     }
 }
 
 bool Poly::operator==(const Poly& other) const {
-    return coefficients_ == other.coefficients_;
+    return dense_ == other.dense_ && sparse_ == other.sparse_;
 }
 
 bool Poly::operator!=(const Poly& other) const {
     return !(*this == other);
 }
 
-Poly& Poly::operator+=(const Poly& other) {
-    for (const auto& [i, coefficient] : other.coefficients_) {
-        coefficients_[i] += coefficient;
-        if (coefficients_[i] == 0) {
-            coefficients_.erase(i);
+Poly& Poly::Intern() {
+    if (dense_.size() <= DENSE_INLINE_LENGTH && sparse_.size() <= 1) {
+        // fits in place, nothing to share
+        dense_.shrink_to_fit();
+        sparse_.shrink_to_fit();
+        return *this;
+    }
+    struct Hash {
+        size_t operator()(const Poly& poly) const {
+            size_t result = 0;
+            poly.ForEachTerm([&] (uint64_t i, const Fraction& coefficient) {
+                result = result * HASH_MULTIPLIER + i;
+                result = result * HASH_MULTIPLIER + coefficient.NumeratorResidue(HASH_MOD);
+                result = result * HASH_MULTIPLIER + coefficient.DenominatorResidue(HASH_MOD);
+            });
+            return result;
+        }
+    };
+    static std::mutex mutex;
+    static std::unordered_set<Poly, Hash> table;
+
+    std::lock_guard lock(mutex);
+    auto it = table.find(*this);
+    if (it == table.end()) {
+        dense_.shrink_to_fit();
+        sparse_.shrink_to_fit();
+        it = table.insert(*this).first;
+        it->dense_.MarkCanonical();
+        it->sparse_.MarkCanonical();
+    }
+    *this = *it;
+    return *this;
+}
+
+void Poly::Add(const Poly& other, bool negative) {
+    if (!IsSparse() && (!other.IsSparse() || other.Degree() < dense_.size())) {
+        if (dense_.size() < other.dense_.size()) {
+            dense_.resize(other.dense_.size());
+        }
+        // taken once, every non-const access checks whether the storage is shared
+        Fraction* destination = dense_.data();
+        other.ForEachTerm([&] (uint64_t i, const Fraction& coefficient) {
+            if (negative) {
+                destination[i] -= coefficient;
+            } else {
+                destination[i] += coefficient;
+            }
+        });
+    } else {
+        // scratch of this call only
+        Arena arena;
+        std::pmr::vector<Term> lhs(arena.Resource());
+        if (IsSparse()) {
+            lhs.assign(std::make_move_iterator(sparse_.begin()), std::make_move_iterator(sparse_.end()));
+        } else {
+            ForEachTerm([&] (uint64_t i, const Fraction& coefficient) { lhs.emplace_back(i, coefficient); });
+        }
+
+        std::pmr::vector<Term> merged(arena.Resource());
+        merged.reserve(lhs.size() + other.NonZeros());
+        auto it = lhs.begin();
+        other.ForEachTerm([&] (uint64_t i, const Fraction& coefficient) {
+            while (it != lhs.end() && it->first < i) {
+                merged.push_back(std::move(*it++));
+            }
+            if (it != lhs.end() && it->first == i) {
+                merged.push_back(std::move(*it++));
+            } else {
+                merged.emplace_back(i, 0);
+            }
+            if (negative) {
+                merged.back().second -= coefficient;
+            } else {
+                merged.back().second += coefficient;
+            }
+        });
+        std::move(it, lhs.end(), std::back_inserter(merged));
+
+        sparse_.assign(std::make_move_iterator(merged.begin()), std::make_move_iterator(merged.end()));
+        dense_.clear();
+    }
+    Canonicalize();
+}
+
+// products go straight into dense storage when the result is dense enough, otherwise they are sorted and merged
+void Poly::Accumulate(const Poly& lhs, const Poly& rhs, bool negative) {
+    if (lhs.IsZero() || rhs.IsZero()) {
+        return;
+    }
+    uint64_t degree;
+    if (__builtin_add_overflow(lhs.Degree(), rhs.Degree(), &degree)) {
+        throw std::overflow_error("poly degree overflow");
+    }
+    uint64_t result_degree = std::max(degree, Degree());
+    if (result_degree < DENSE_MIN_DEGREE
+        || PreferDense(result_degree, lhs.NonZeros() * rhs.NonZeros() + NonZeros()))
+    {
+        if (!lhs.IsSparse() && !rhs.IsSparse() && std::min(lhs.dense_.size(), rhs.dense_.size()) >= KARATSUBA_MIN_LENGTH) {
+            Arena arena;
+            auto product = MultiplyDense(lhs.dense_, rhs.dense_, arena.Resource());
+            if (IsZero() && !negative) {
+                dense_.assign(std::make_move_iterator(product.begin()), std::make_move_iterator(product.end()));
+            } else {
+                MakeDense();
+                if (dense_.size() < product.size()) {
+                    dense_.resize(product.size());
+                }
+                Fraction* destination = dense_.data();
+                for (size_t i = 0; i < product.size(); ++i) {
+                    if (negative) {
+                        destination[i] -= product[i];
+                    } else {
+                        destination[i] += product[i];
+                    }
+                }
+            }
+            Canonicalize();
+            return;
+        }
+        MakeDense();
+        if (dense_.size() <= degree) {
+            dense_.resize(degree + 1);
+        }
+        Fraction* destination = dense_.data();
+        lhs.ForEachTerm([&] (uint64_t i, const Fraction& lhs_coefficient) {
+            rhs.ForEachTerm([&] (uint64_t j, const Fraction& rhs_coefficient) {
+                if (negative) {
+                    destination[i + j] -= lhs_coefficient * rhs_coefficient;
+                } else {
+                    destination[i + j] += lhs_coefficient * rhs_coefficient;
+                }
+            });
+        });
+        Canonicalize();
+        return;
+    }
+
+    Arena arena;
+    std::pmr::vector<Term> lhs_terms(arena.Resource());
+    std::pmr::vector<Term> rhs_terms(arena.Resource());
+    const auto terms_of = [] (const Poly& poly, std::pmr::vector<Term>& buffer) -> std::span<const Term> {
+        if (poly.IsSparse()) {
+            return poly.sparse_;
         }
+        poly.ForEachTerm([&] (uint64_t i, const Fraction& coefficient) { buffer.emplace_back(i, coefficient); });
+        return buffer;
+    };
+    auto lhs_span = terms_of(lhs, lhs_terms);
+    auto rhs_span = terms_of(rhs, rhs_terms);
+    if (lhs_span.size() > rhs_span.size()) {
+        std::swap(lhs_span, rhs_span);
+    }
+
+    Poly product;
+    auto product_terms = MultiplyHeap(lhs_span, rhs_span, arena.Resource());
+    product.sparse_.assign(std::make_move_iterator(product_terms.begin()), std::make_move_iterator(product_terms.end()));
+    product.Canonicalize();
+    if (IsZero() && !negative) {
+        *this = std::move(product);
+    } else {
+        Add(product, negative);
     }
+}
+
+Poly& Poly::operator+=(const Poly& other) {
+    if (this == &other) {
+        return *this += Poly(other);
+    }
+    Add(other, false);
     return *this;
 }
 
 Poly& Poly::operator-=(const Poly& other) {
-    return *this += -other;
+    if (this == &other) {
+        *this = Poly();
+        return *this;
+    }
+    Add(other, true);
+    return *this;
 }
 
 Poly& Poly::operator*=(const Poly& other) {
-    std::unordered_map<uint64_t, Fraction> new_coefficients;
-    for (const auto& [i, lhs_coefficient] : coefficients_) {
-        for (const auto& [j, rhs_coefficient] : other.coefficients_) {
-            new_coefficients[i + j] += lhs_coefficient * rhs_coefficient;
-        }
+    Poly product;
+    product.Accumulate(*this, other, false);
+    *this = std::move(product);
+    return *this;
+}
+
+Poly& Poly::AddProduct(const Poly& lhs, const Poly& rhs) {
+    if (this == &lhs || this == &rhs) {
+        return *this += lhs * rhs;
     }
-    coefficients_ = new_coefficients;
+    Accumulate(lhs, rhs, false);
     return *this;
 }
 
+Poly& Poly::SubProduct(const Poly& lhs, const Poly& rhs) {
+    if (this == &lhs || this == &rhs) {
+        return *this -= lhs * rhs;
+    }
+    Accumulate(lhs, rhs, true);
+    return *this;
+}
+
+// turns *this into the remainder of the division and returns the quotient
+Poly Poly::DivideInPlace(const Poly& divisor) {
+    if (divisor.IsZero()) {
+        throw "division by zero poly";
+    }
+    uint64_t divisor_degree = divisor.Degree();
+    const Fraction leading = divisor.Leading();
+    Poly quotient;
+    if (divisor_degree == 0) {
+        quotient = std::move(*this);
+        *this = Poly();
+        for (auto& coefficient : quotient.dense_) {
+            coefficient /= leading;
+        }
+        for (auto& [i, coefficient] : quotient.sparse_) {
+            coefficient /= leading;
+        }
+        return quotient;
+    }
+
+    Arena arena;
+    std::pmr::vector<Term> quotient_terms(arena.Resource());
+    if (!IsSparse()) {
+        auto& remainder = dense_;
+        for (uint64_t top = remainder.size(); top-- > divisor_degree;) {
+            if (IsZeroCoefficient(remainder[top])) {
+                continue;
+            }
+            uint64_t shift = top - divisor_degree;
+            Fraction factor = remainder[top] / leading;
+            divisor.ForEachTerm([&] (uint64_t i, const Fraction& coefficient) {
+                remainder[i + shift] -= coefficient * factor;
+            });
+            quotient_terms.emplace_back(shift, std::move(factor));
+        }
+    } else {
+        // read through const, a shared storage isn't copied only to be replaced
+        const auto& terms = sparse_;
+        std::pmr::map<uint64_t, Fraction> remainder(terms.begin(), terms.end(), arena.Resource());
+        while (!remainder.empty() && remainder.rbegin()->first >= divisor_degree) {
+            auto [current_degree, current] = *remainder.rbegin();
+            uint64_t shift = current_degree - divisor_degree;
+            Fraction factor = current / leading;
+            divisor.ForEachTerm([&] (uint64_t i, const Fraction& coefficient) {
+                auto& value = remainder[i + shift];
+                value -= coefficient * factor;
+                if (IsZeroCoefficient(value)) {
+                    remainder.erase(i + shift);
+                }
+            });
+            quotient_terms.emplace_back(shift, std::move(factor));
+        }
+        sparse_.assign(remainder.begin(), remainder.end());
+    }
+    Canonicalize();
+    quotient.SetTerms(quotient_terms);
+    return quotient;
+}
+
 Poly& Poly::operator/=(const Poly& other) {
-    const static auto isNumber = [] (const Poly& poly) {
-        return poly.coefficients_.empty() || poly.coefficients_.size() == 1 && poly.coefficients_.count(0);
-    };
-    if (!isNumber(*this) || !isNumber(other)) {
-        // only for matrix
-        throw "only numbers please";
+    if (this == &other) {
+        return *this /= Poly(other);
     }
-    coefficients_[0] /= other.coefficients_.at(0);
+    Poly quotient = DivideInPlace(other);
+    if (!IsZero()) {
+        throw "poly is not divisible";
+    }
+    *this = std::move(quotient);
     return *this;
 }
 
-Poly Poly::operator-() const {
-    Poly result = *this;
-    for (const auto& [i, coefficient] : coefficients_) {
-        result.coefficients_[i] = -coefficient;
+Poly Poly::operator-() const& {
+    return -Poly(*this);
+}
+
+Poly Poly::operator-() && {
+    for (auto& coefficient : dense_) {
+        coefficient = -std::move(coefficient);
     }
-    return result;
+    for (auto& [i, coefficient] : sparse_) {
+        coefficient = -std::move(coefficient);
+    }
+    return std::move(*this);
 }
 
-Fraction Poly::operator()(int64_t x) const {
+// Horner's rule, gaps between exponents of sparse polys are covered by binary powers
+Fraction Poly::operator()(const Fraction& x) const {
     Fraction result = 0;
-    for (const auto& [i, coefficient] : coefficients_) {
-        result += coefficient * BinaryPow(x, i);
+    if (!IsSparse()) {
+        for (uint64_t i = dense_.size(); i-- > 0;) {
+            result = result * x + dense_[i];
+        }
+        return result;
+    }
+    uint64_t exponent = sparse_.back().first;
+    for (auto it = sparse_.rbegin(); it != sparse_.rend(); ++it) {
+        result = result * Power(x, exponent - it->first) + it->second;
+        exponent = it->first;
+    }
+    return result * Power(x, exponent);
+}
+
+std::vector<Fraction> Poly::operator()(std::span<const Fraction> points) const {
+    if (!IsSparse() && Degree() >= MULTIPOINT_MIN_DEGREE && points.size() >= MULTIPOINT_MIN_POINTS) {
+        if (auto values = ModularEvaluate(*this, points)) {
+            return std::move(*values);
+        }
+    }
+    std::vector<Fraction> values(points.size());
+    ThreadPool::Instance().ParallelFor(0, points.size(), [&] (size_t i) {
+        values[i] = (*this)(points[i]);
+    }, ThreadPool::Grain(NonZeros() + 1));
+    return values;
+}
+
+uint64_t Poly::Degree() const {
+    if (IsSparse()) {
+        return sparse_.back().first;
+    }
+    return dense_.empty() ? 0 : dense_.size() - 1;
+}
+
+Fraction Poly::Leading() const {
+    if (IsSparse()) {
+        return sparse_.back().second;
+    }
+    return dense_.empty() ? Fraction(0) : dense_.back();
+}
+
+std::vector<std::pair<uint64_t, Fraction>> Poly::Terms() const {
+    if (IsSparse()) {
+        return {sparse_.begin(), sparse_.end()};
     }
+    std::vector<Term> result;
+    ForEachTerm([&] (uint64_t i, const Fraction& coefficient) { result.emplace_back(i, coefficient); });
     return result;
 }
 
+bool Poly::IsZero() const {
+    return !IsSparse() && dense_.empty();
+}
+
+bool Poly::IsNumber() const {
+    return !IsSparse() && dense_.size() <= 1;
+}
+
 std::string Poly::AsString() const {
-    if (coefficients_.empty()) {
+    if (IsZero()) {
         return "0";
     }
     std::string result = "";
-    std::map<uint64_t, Fraction> sorted_coefficients;
-    for (const auto& pair : coefficients_) {
-        sorted_coefficients.emplace(pair);
-    }
     bool is_first = true;
-    for (auto it = sorted_coefficients.rbegin(); it != sorted_coefficients.rend(); ++it) {
+    const auto append = [&] (uint64_t i, const Fraction& coefficient) {
         if (is_first) {
-            if (it->second < 0) {
+            if (coefficient < 0) {
                 result += '-';
             }
         } else {
-            result += it->second > 0 ? " + " : " - ";
+            result += coefficient > 0 ? " + " : " - ";
         }
-        Fraction positive = it->second > 0 ? it->second : -it->second;
+        Fraction positive = coefficient > 0 ? coefficient : -coefficient;
         result += positive.AsString();
-        if (it->first > 0) {
-            result += "x^" + std::to_string(it->first);
+        if (i > 0) {
+            result += "x^" + std::to_string(i);
         }
         is_first = false;
+    };
+    if (IsSparse()) {
+        for (auto it = sparse_.rbegin(); it != sparse_.rend(); ++it) {
+            append(it->first, it->second);
+        }
+    } else {
+        for (uint64_t i = dense_.size(); i-- > 0;) {
+            if (!IsZeroCoefficient(dense_[i])) {
+                append(i, dense_[i]);
+            }
+        }
     }
     return result;
 }
 
+std::pair<Poly, Poly> DivideWithRemainder(const Poly& lhs, const Poly& rhs) {
+    Poly remainder = lhs;
+    Poly quotient = remainder.DivideInPlace(rhs);
+    return {std::move(quotient), std::move(remainder)};
+}
+
+std::pair<Poly, Poly> PseudoDivide(const Poly& lhs, const Poly& rhs) {
+    if (rhs.IsZero()) {
+        throw "division by zero poly";
+    }
+    Poly leading{rhs.Leading()};
+    Poly quotient;
+    Poly remainder = lhs;
+    uint64_t steps = lhs.Degree() >= rhs.Degree() ? lhs.Degree() - rhs.Degree() + 1 : 0;
+    while (!remainder.IsZero() && remainder.Degree() >= rhs.Degree()) {
+        Poly term{{remainder.Degree() - rhs.Degree(), remainder.Leading()}};
+        quotient *= leading;
+        quotient += term;
+        remainder *= leading;
+        remainder.SubProduct(term, rhs);
+        --steps;
+    }
+    for (; steps > 0; --steps) {
+        quotient *= leading;
+        remainder *= leading;
+    }
+    return {std::move(quotient), std::move(remainder)};
+}
+
+// modular gcd first, then the subresultant remainder sequence: dividing each pseudo-remainder by g * h^delta keeps the
+// coefficients as small as the subresultants instead of growing exponentially as in plain Euclid
+Poly Gcd(const Poly& lhs, const Poly& rhs) {
+    Poly a = lhs.Degree() >= rhs.Degree() ? lhs : rhs;
+    Poly b = lhs.Degree() >= rhs.Degree() ? rhs : lhs;
+    if (b.IsZero()) {
+        return a.IsZero() ? a : a / Poly{a.Leading()};
+    }
+    if (b.Degree() == 0) {
+        return Poly{1};
+    }
+    if (auto result = ModularGcd(a, b)) {
+        return *result;
+    }
+
+    Fraction g = 1;
+    Fraction h = 1;
+    while (true) {
+        uint64_t delta = a.Degree() - b.Degree();
+        Poly remainder = PseudoDivide(a, b).second;
+        if (remainder.IsZero()) {
+            return b / Poly{b.Leading()};
+        }
+        if (remainder.Degree() == 0) {
+            return Poly{1};
+        }
+        Fraction h_power = 1;
+        for (uint64_t i = 0; i < delta; ++i) {
+            h_power *= h;
+        }
+        remainder /= Poly{g * h_power};
+        a = std::move(b);
+        b = std::move(remainder);
+
+        g = a.Leading();
+        // h = g^delta / h^(delta - 1)
+        Fraction g_power = 1;
+        for (uint64_t i = 0; i < delta; ++i) {
+            g_power *= g;
+        }
+        h = delta == 0 ? h : g_power / (h_power / h);
+    }
+}
+
 Poly operator+(const Poly& lhs, const Poly& rhs) {
     Poly result = lhs;
     result += rhs;
@@ -189,8 +783,8 @@ Poly operator-(const Poly& lhs, const Poly& rhs) {
 }
 
 Poly operator*(const Poly& lhs, const Poly& rhs) {
-    Poly result = lhs;
-    result *= rhs;
+    Poly result;
+    result.AddProduct(lhs, rhs);
     return result;
 }
 
@@ -200,6 +794,21 @@ Poly operator/(const Poly& lhs, const Poly& rhs) {
     return result;
 }
 
+Poly operator+(Poly&& lhs, const Poly& rhs) {
+    lhs += rhs;
+    return std::move(lhs);
+}
+
+Poly operator-(Poly&& lhs, const Poly& rhs) {
+    lhs -= rhs;
+    return std::move(lhs);
+}
+
+Poly operator/(Poly&& lhs, const Poly& rhs) {
+    lhs /= rhs;
+    return std::move(lhs);
+}
+
 std::ostream& operator<<(std::ostream& os, const Poly& poly) {
     return os << poly.AsString();
 }
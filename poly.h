@@ -1,26 +1,32 @@
 #pragma once
 
 #include "fraction.h"
+#include "small_vector.h"
 
 #include <cstdint>
 #include <iostream>
+#include <span>
 #include <string>
 #include <string_view>
-#include <unordered_map>
+#include <utility>
+#include <vector>
 
 class Poly {
 public:
+    friend std::pair<Poly, Poly> DivideWithRemainder(const Poly& lhs, const Poly& rhs);
+
     Poly() = default;
     Poly(std::string_view  str);
 
     Poly(const Poly& other) = default;
-    Poly(Poly&& other) = default;
+    Poly(Poly&& other) noexcept = default;
 
     Poly& operator=(const Poly& other) = default;
-    Poly& operator=(Poly&& other) = default;
+    Poly& operator=(Poly&& other) noexcept = default;
 
     Poly(const std::initializer_list<Fraction>& coefficients);
     Poly(const std::initializer_list<std::pair<uint64_t, Fraction>>& coefficients);
+    explicit Poly(std::vector<std::pair<uint64_t, Fraction>> terms);
 
     bool operator==(const Poly& other) const;
     bool operator!=(const Poly& other) const;
@@ -28,15 +34,61 @@ public:
     Poly& operator+=(const Poly& other);
     Poly& operator-=(const Poly& other);
     Poly& operator*=(const Poly& other);
+    // exact division, throws if there is a remainder
     Poly& operator/=(const Poly& other);
-    Poly operator-() const;
+    Poly operator-() const&;
+    // negates the coefficients in place
+    Poly operator-() &&;
+
+    // *this += lhs * rhs and *this -= lhs * rhs without building the product
+    Poly& AddProduct(const Poly& lhs, const Poly& rhs);
+    Poly& SubProduct(const Poly& lhs, const Poly& rhs);
+
+    // exact value
+    Fraction operator()(const Fraction& x) const;
+    // values at all the points, large batches of dense polys are evaluated modulo primes
+    // by a subproduct tree in O(M(n) log n) instead of n Horner passes
+    std::vector<Fraction> operator()(std::span<const Fraction> points) const;
 
-    Fraction operator()(int64_t x) const;
+    uint64_t Degree() const;
+    Fraction Leading() const;
+    // nonzero terms by growing exponent
+    std::vector<std::pair<uint64_t, Fraction>> Terms() const;
+
+    bool IsZero() const;
+    bool IsNumber() const;
+
+    // Shares the coefficients with an equal poly interned before, so repeated entries are stored once
+    // and compare by pointer. Interned polys stay in the table until the program ends.
+    Poly& Intern();
 
     std::string AsString() const;
 
 private:
-    std::unordered_map<uint64_t, Fraction> coefficients_;
+    using Term = std::pair<uint64_t, Fraction>;
+
+    static constexpr size_t DENSE_INLINE_LENGTH = 2;
+
+    template <class Function>
+    void ForEachTerm(Function&& function) const;
+    bool IsSparse() const;
+    size_t NonZeros() const;
+
+    Poly DivideInPlace(const Poly& divisor);
+    void Add(const Poly& other, bool negative);
+    void Accumulate(const Poly& lhs, const Poly& rhs, bool negative);
+
+    void SetTerms(std::span<Term> terms);
+    void SortTerms();
+    void MakeDense();
+    void Canonicalize();
+
+    // dense_[i] is the coefficient of x^i without trailing zeros, polys that would be mostly zeros
+    // keep their nonzero terms sorted by exponent in sparse_ instead, at most one of them is nonempty.
+    // Constants, linear polys and single sparse terms, most matrix cells, are kept in place and cost
+    // no allocation, longer coefficient arrays are shared between copies until one of them is changed
+    SmallVector<Fraction, DENSE_INLINE_LENGTH> dense_;
+    SmallVector<Term, 1> sparse_;
 };
 
 Poly operator+(const Poly& lhs, const Poly& rhs);
@@ -44,5 +96,17 @@ Poly operator-(const Poly& lhs, const Poly& rhs);
 Poly operator*(const Poly& lhs, const Poly& rhs);
 Poly operator/(const Poly& lhs, const Poly& rhs);
 
+// a temporary lhs is updated and returned instead of being copied, a product is built anew either way
+Poly operator+(Poly&& lhs, const Poly& rhs);
+Poly operator-(Poly&& lhs, const Poly& rhs);
+Poly operator/(Poly&& lhs, const Poly& rhs);
+
+// quotient and remainder over the rationals
+std::pair<Poly, Poly> DivideWithRemainder(const Poly& lhs, const Poly& rhs);
+// quotient and remainder of lc(rhs)^(deg lhs - deg rhs + 1) * lhs, integer polys stay integer
+std::pair<Poly, Poly> PseudoDivide(const Poly& lhs, const Poly& rhs);
+// monic greatest common divisor, Gcd(0, 0) = 0
+Poly Gcd(const Poly& lhs, const Poly& rhs);
+
 std::ostream& operator<<(std::ostream& os, const Poly& poly);
 std::istream& operator>>(std::istream& is, Poly& poly);
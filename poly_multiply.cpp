@@ -0,0 +1,328 @@
+#include "poly_multiply.h"
+
+#include "arena.h"
+#include "montgomery.h"
+#include "thread_pool.h"
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cmath>
+#include <numeric>
+#include <optional>
+#include <stdexcept>
+
+namespace {
+    constexpr size_t NTT_MAX_LENGTH = size_t{1} << 25;
+
+    using uint128 = unsigned __int128;
+    using int128 = __int128;
+
+    bool IsZeroCoefficient(const Fraction& value) {
+        return value.IsZero();
+    }
+
+    void MultiplySchoolbook(std::span<const Fraction> lhs, std::span<const Fraction> rhs, std::span<Fraction> result) {
+        for (size_t i = 0; i < lhs.size(); ++i) {
+            if (IsZeroCoefficient(lhs[i])) {
+                continue;
+            }
+            for (size_t j = 0; j < rhs.size(); ++j) {
+                if (!IsZeroCoefficient(rhs[j])) {
+                    result[i + j] += lhs[i] * rhs[j];
+                }
+            }
+        }
+    }
+
+    // result += lhs * rhs for operands of equal length, result has 2 * length - 1 elements,
+    // the temporaries of every level go back to the thread's pool before the next one needs them
+    void MultiplyKaratsuba(std::span<const Fraction> lhs, std::span<const Fraction> rhs, std::span<Fraction> result) {
+        size_t length = lhs.size();
+        if (length < KARATSUBA_MIN_LENGTH) {
+            MultiplySchoolbook(lhs, rhs, result);
+            return;
+        }
+        size_t low = length / 2;
+        size_t high = length - low;
+        std::pmr::memory_resource* pool = Arena::LocalPool();
+
+        std::pmr::vector<Fraction> low_product(2 * low - 1, pool);
+        std::pmr::vector<Fraction> high_product(2 * high - 1, pool);
+        MultiplyKaratsuba(lhs.first(low), rhs.first(low), low_product);
+        MultiplyKaratsuba(lhs.subspan(low), rhs.subspan(low), high_product);
+
+        std::pmr::vector<Fraction> lhs_sum(lhs.begin() + low, lhs.end(), pool);
+        std::pmr::vector<Fraction> rhs_sum(rhs.begin() + low, rhs.end(), pool);
+        for (size_t i = 0; i < low; ++i) {
+            lhs_sum[i] += lhs[i];
+            rhs_sum[i] += rhs[i];
+        }
+        std::pmr::vector<Fraction> middle(2 * high - 1, pool);
+        MultiplyKaratsuba(lhs_sum, rhs_sum, middle);
+        for (size_t i = 0; i < low_product.size(); ++i) {
+            middle[i] -= low_product[i];
+            result[i] += low_product[i];
+        }
+        for (size_t i = 0; i < high_product.size(); ++i) {
+            middle[i] -= high_product[i];
+            result[i + 2 * low] += high_product[i];
+        }
+        for (size_t i = 0; i < middle.size(); ++i) {
+            result[i + low] += middle[i];
+        }
+    }
+
+    // the longer operand is cut into pieces as long as the shorter one
+    std::pmr::vector<Fraction> MultiplyKaratsuba(std::span<const Fraction> lhs, std::span<const Fraction> rhs,
+                                                 std::pmr::memory_resource* resource) {
+        if (lhs.size() < rhs.size()) {
+            std::swap(lhs, rhs);
+        }
+        std::pmr::memory_resource* pool = Arena::LocalPool();
+        std::pmr::vector<Fraction> result(lhs.size() + rhs.size() - 1, resource);
+        std::pmr::vector<Fraction> piece(rhs.size(), pool);
+        std::pmr::vector<Fraction> product(2 * rhs.size() - 1, pool);
+        for (size_t offset = 0; offset < lhs.size(); offset += rhs.size()) {
+            size_t length = std::min(rhs.size(), lhs.size() - offset);
+            std::copy_n(lhs.begin() + offset, length, piece.begin());
+            std::fill(piece.begin() + length, piece.end(), Fraction());
+            std::fill(product.begin(), product.end(), Fraction());
+            MultiplyKaratsuba(piece, rhs, product);
+            size_t used = std::min(product.size(), result.size() - offset);
+            for (size_t i = 0; i < used; ++i) {
+                result[offset + i] += product[i];
+            }
+        }
+        return result;
+    }
+
+
+    // in-place transform of Montgomery residues, the length is a power of two
+    void Transform(std::vector<uint32_t>& values, const Montgomery& field, uint32_t generator, bool inverse) {
+        size_t length = values.size();
+        for (size_t i = 1, j = 0; i < length; ++i) {
+            size_t bit = length >> 1;
+            for (; j & bit; bit >>= 1) {
+                j ^= bit;
+            }
+            j ^= bit;
+            if (i < j) {
+                std::swap(values[i], values[j]);
+            }
+        }
+
+        std::vector<uint32_t> twiddles;
+        for (size_t block = 2; block <= length; block <<= 1) {
+            uint32_t root = field.Power(field.To(generator), (field.Mod() - 1) / block);
+            if (inverse) {
+                root = field.Inverse(root);
+            }
+            twiddles.assign(1, field.To(1));
+            for (size_t k = 1; k < block / 2; ++k) {
+                twiddles.push_back(field.Multiply(twiddles.back(), root));
+            }
+            for (size_t start = 0; start < length; start += block) {
+                for (size_t k = 0; k < block / 2; ++k) {
+                    uint32_t u = values[start + k];
+                    uint32_t v = field.Multiply(values[start + k + block / 2], twiddles[k]);
+                    values[start + k] = field.Add(u, v);
+                    values[start + k + block / 2] = field.Sub(u, v);
+                }
+            }
+        }
+
+        if (inverse) {
+            uint32_t scale = field.Inverse(field.To(static_cast<uint32_t>(length % field.Mod())));
+            for (auto& value : values) {
+                value = field.Multiply(value, scale);
+            }
+        }
+    }
+
+    struct IntegerPoly {
+        std::vector<int64_t> numerators;
+        int64_t denominator = 1;
+        uint64_t max_abs = 0;
+    };
+
+    // coefficients over a common denominator, nullopt if it overflows
+    std::optional<IntegerPoly> ToIntegers(std::span<const Fraction> values) {
+        IntegerPoly result;
+        for (const auto& value : values) {
+            if (!value.IsSmall()) {
+                return std::nullopt;
+            }
+            int64_t down = value.Denominator();
+            int64_t factor = down / std::gcd(result.denominator, down);
+            if (__builtin_mul_overflow(result.denominator, factor, &result.denominator)) {
+                return std::nullopt;
+            }
+        }
+        result.numerators.reserve(values.size());
+        for (const auto& value : values) {
+            int64_t numerator;
+            if (__builtin_mul_overflow(value.Numerator(), result.denominator / value.Denominator(), &numerator)
+                || numerator == INT64_MIN)
+            {
+                return std::nullopt;
+            }
+            result.numerators.push_back(numerator);
+            result.max_abs = std::max(result.max_abs, static_cast<uint64_t>(std::abs(numerator)));
+        }
+        return result;
+    }
+
+    uint128 Gcd(uint128 lhs, uint128 rhs) {
+        while (rhs != 0) {
+            lhs %= rhs;
+            std::swap(lhs, rhs);
+        }
+        return lhs;
+    }
+
+    std::optional<std::pmr::vector<Fraction>> MultiplyNtt(std::span<const Fraction> lhs, std::span<const Fraction> rhs,
+                                                          std::pmr::memory_resource* resource) {
+        size_t result_length = lhs.size() + rhs.size() - 1;
+        size_t length = std::bit_ceil(result_length);
+        if (length > NTT_MAX_LENGTH) {
+            return std::nullopt;
+        }
+        auto lhs_integers = ToIntegers(lhs);
+        auto rhs_integers = ToIntegers(rhs);
+        if (!lhs_integers || !rhs_integers) {
+            return std::nullopt;
+        }
+
+        // primes are taken until their product exceeds twice the largest possible coefficient
+        double bound_bits = std::log2(static_cast<double>(lhs_integers->max_abs) + 1)
+            + std::log2(static_cast<double>(rhs_integers->max_abs) + 1)
+            + std::log2(static_cast<double>(std::min(lhs.size(), rhs.size()))) + 2;
+        size_t primes = 0;
+        for (double modulus_bits = 0; modulus_bits < bound_bits; ++primes) {
+            if (primes == NTT_PRIMES.size()) {
+                return std::nullopt;
+            }
+            modulus_bits += std::log2(static_cast<double>(NTT_PRIMES[primes].mod));
+        }
+
+        std::vector<std::vector<uint32_t>> residues(primes);
+        std::vector<std::function<void()>> tasks;
+        for (size_t p = 0; p < primes; ++p) {
+            tasks.push_back([&, p] {
+                Montgomery field(NTT_PRIMES[p].mod);
+                auto reduce = [&] (const std::vector<int64_t>& numerators) {
+                    std::vector<uint32_t> result(length, 0);
+                    for (size_t i = 0; i < numerators.size(); ++i) {
+                        result[i] = field.To(field.Residue(numerators[i]));
+                    }
+                    Transform(result, field, NTT_PRIMES[p].generator, false);
+                    return result;
+                };
+                auto lhs_values = reduce(lhs_integers->numerators);
+                auto rhs_values = reduce(rhs_integers->numerators);
+                for (size_t i = 0; i < length; ++i) {
+                    lhs_values[i] = field.Multiply(lhs_values[i], rhs_values[i]);
+                }
+                Transform(lhs_values, field, NTT_PRIMES[p].generator, true);
+                for (auto& value : lhs_values) {
+                    value = field.From(value);
+                }
+                residues[p] = std::move(lhs_values);
+            });
+        }
+        ThreadPool::Instance().Run(tasks);
+
+        // Garner's mixed radix CRT, inverses[p] is the inverse of mod_0 * ... * mod_{p-1} modulo mod_p
+        std::vector<uint64_t> inverses(primes);
+        uint128 modulus = 1;
+        for (size_t p = 0; p < primes; ++p) {
+            Montgomery field(NTT_PRIMES[p].mod);
+            uint32_t prefix = static_cast<uint32_t>(modulus % NTT_PRIMES[p].mod);
+            inverses[p] = field.From(field.Inverse(field.To(prefix)));
+            modulus *= NTT_PRIMES[p].mod;
+        }
+
+        uint128 denominator = static_cast<uint128>(lhs_integers->denominator) * rhs_integers->denominator;
+        std::pmr::vector<Fraction> result(resource);
+        result.reserve(result_length);
+        for (size_t i = 0; i < result_length; ++i) {
+            uint128 value = 0;
+            uint128 prefix = 1;
+            for (size_t p = 0; p < primes; ++p) {
+                uint64_t mod = NTT_PRIMES[p].mod;
+                uint64_t current = static_cast<uint64_t>(value % mod);
+                uint64_t difference = (residues[p][i] + mod - current) % mod;
+                value += prefix * (difference * inverses[p] % mod);
+                prefix *= mod;
+            }
+            bool negative = value > modulus / 2;
+            uint128 magnitude = negative ? modulus - value : value;
+            uint128 gcd = Gcd(magnitude, denominator);
+            uint128 up = magnitude / gcd;
+            uint128 down = denominator / gcd;
+            if (up > INT64_MAX || down > INT64_MAX) {
+                auto signed_up = static_cast<int128>(up);
+                result.emplace_back(BigInt::FromInt128(negative ? -signed_up : signed_up),
+                                    BigInt::FromInt128(static_cast<int128>(down)));
+                continue;
+            }
+            int64_t numerator = static_cast<int64_t>(up);
+            result.emplace_back(negative ? -numerator : numerator, static_cast<int64_t>(down));
+        }
+        return result;
+    }
+}
+
+std::pmr::vector<Fraction> MultiplyDense(std::span<const Fraction> lhs, std::span<const Fraction> rhs,
+                                         std::pmr::memory_resource* resource) {
+    if (lhs.empty() || rhs.empty()) {
+        return std::pmr::vector<Fraction>(resource);
+    }
+    size_t shorter = std::min(lhs.size(), rhs.size());
+    if (shorter >= NTT_MIN_LENGTH) {
+        if (auto result = MultiplyNtt(lhs, rhs, resource)) {
+            return std::move(*result);
+        }
+    }
+    if (shorter >= KARATSUBA_MIN_LENGTH) {
+        return MultiplyKaratsuba(lhs, rhs, resource);
+    }
+    std::pmr::vector<Fraction> result(lhs.size() + rhs.size() - 1, resource);
+    MultiplySchoolbook(lhs, rhs, result);
+    return result;
+}
+
+std::vector<uint32_t> MultiplyModulo(std::span<const uint32_t> lhs, std::span<const uint32_t> rhs, const NttPrime& prime) {
+    if (lhs.empty() || rhs.empty()) {
+        return {};
+    }
+    Montgomery field(prime.mod);
+    size_t result_length = lhs.size() + rhs.size() - 1;
+    if (std::min(lhs.size(), rhs.size()) < NTT_MIN_LENGTH) {
+        std::vector<uint32_t> result(result_length, 0);
+        for (size_t i = 0; i < lhs.size(); ++i) {
+            for (size_t j = 0; j < rhs.size(); ++j) {
+                result[i + j] = field.Add(result[i + j], field.Multiply(lhs[i], rhs[j]));
+            }
+        }
+        return result;
+    }
+
+    size_t length = std::bit_ceil(result_length);
+    if (length > NTT_MAX_LENGTH) {
+        throw std::length_error("poly is too long for NTT");
+    }
+    std::vector<uint32_t> result(length, 0);
+    std::vector<uint32_t> rhs_values(length, 0);
+    std::copy(lhs.begin(), lhs.end(), result.begin());
+    std::copy(rhs.begin(), rhs.end(), rhs_values.begin());
+    Transform(result, field, prime.generator, false);
+    Transform(rhs_values, field, prime.generator, false);
+    for (size_t i = 0; i < length; ++i) {
+        result[i] = field.Multiply(result[i], rhs_values[i]);
+    }
+    Transform(result, field, prime.generator, true);
+    result.resize(result_length);
+    return result;
+}
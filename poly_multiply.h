@@ -0,0 +1,33 @@
+#pragma once
+
+#include "fraction.h"
+
+#include <array>
+#include <cstdint>
+#include <memory_resource>
+#include <span>
+#include <vector>
+
+// Products of dense coefficient vectors, the coefficient of x^i is at i. Schoolbook is used for
+// short operands, Karatsuba from KARATSUBA_MIN_LENGTH and NTT modulo several primes from
+// NTT_MIN_LENGTH when the integer product fits into their CRT range. The product is allocated
+// from resource, usually the Arena of the caller.
+
+inline constexpr size_t KARATSUBA_MIN_LENGTH = 16;
+inline constexpr size_t NTT_MIN_LENGTH = 32;
+
+std::pmr::vector<Fraction> MultiplyDense(std::span<const Fraction> lhs, std::span<const Fraction> rhs,
+                                         std::pmr::memory_resource* resource);
+
+struct NttPrime {
+    uint32_t mod;
+    uint32_t generator;
+};
+
+// primes c * 2^k + 1 below 2^31 with k >= 25 and their primitive roots
+inline constexpr std::array<NttPrime, 4> NTT_PRIMES = {{
+    {2013265921, 31}, {1811939329, 13}, {469762049, 3}, {2113929217, 5},
+}};
+
+// product of residue vectors in Montgomery form (R = 2^32) modulo one of NTT_PRIMES
+std::vector<uint32_t> MultiplyModulo(std::span<const uint32_t> lhs, std::span<const uint32_t> rhs, const NttPrime& prime);
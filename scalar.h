@@ -0,0 +1,114 @@
+#pragma once
+
+#include "checked_int.h"
+#include "fraction.h"
+#include "poly.h"
+
+#include <charconv>
+#include <cmath>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <utility>
+
+// What the matrix code needs from its element types besides arithmetic operators.
+// Supported elements: CheckedInt, Fraction, double and Poly.
+
+template <typename T>
+concept Scalar = std::is_same_v<T, CheckedInt> || std::is_same_v<T, Fraction>
+    || std::is_same_v<T, double> || std::is_same_v<T, Poly>;
+
+// division is exact, so Gauss elimination and inversion work
+template <Scalar T>
+inline constexpr bool IS_FIELD = !std::is_same_v<T, CheckedInt>;
+
+template <Scalar T>
+inline constexpr bool IS_APPROXIMATE = std::is_floating_point_v<T>;
+
+template <Scalar T>
+bool IsZero(const T& value) {
+    return value == T{};
+}
+
+inline bool IsZero(const Fraction& value) {
+    return value.IsZero();
+}
+
+inline bool IsZero(const Poly& value) {
+    return value.IsZero();
+}
+
+template <Scalar T>
+void AddProduct(T& destination, const T& lhs, const T& rhs) {
+    destination += lhs * rhs;
+}
+
+template <Scalar T>
+void SubProduct(T& destination, const T& lhs, const T& rhs) {
+    destination -= lhs * rhs;
+}
+
+inline void AddProduct(Poly& destination, const Poly& lhs, const Poly& rhs) {
+    destination.AddProduct(lhs, rhs);
+}
+
+inline void SubProduct(Poly& destination, const Poly& lhs, const Poly& rhs) {
+    destination.SubProduct(lhs, rhs);
+}
+
+// what dot products are summed in: fraction sums are reduced once instead of after every term
+template <Scalar T>
+using Accumulator = std::conditional_t<std::is_same_v<T, Fraction>, FractionAccumulator, T>;
+
+inline void AddProduct(FractionAccumulator& destination, const Fraction& lhs, const Fraction& rhs) {
+    destination.AddProduct(lhs, rhs);
+}
+
+template <Scalar T>
+T Accumulated(Accumulator<T>& sum) {
+    if constexpr (std::is_same_v<T, Fraction>) {
+        return sum.Result();
+    } else {
+        return std::move(sum);
+    }
+}
+
+template <Scalar T>
+std::string AsString(const T& value) {
+    if constexpr (std::is_same_v<T, double>) {
+        char buffer[32];
+        return {buffer, std::to_chars(buffer, buffer + sizeof(buffer), value).ptr};
+    } else {
+        return value.AsString();
+    }
+}
+
+template <Scalar T>
+T ParseScalar(std::string_view str) {
+    if constexpr (std::is_same_v<T, double>) {
+        return Fraction(str).ToDouble();
+    } else if constexpr (std::is_same_v<T, Poly>) {
+        // input matrices repeat their entries a lot
+        Poly result(str);
+        result.Intern();
+        return result;
+    } else {
+        return T(str);
+    }
+}
+
+// lossless widening CheckedInt -> Fraction -> Poly, and anything numeric -> double
+template <Scalar To, Scalar From>
+To ScalarCast(const From& value) {
+    if constexpr (std::is_same_v<To, From>) {
+        return value;
+    } else if constexpr (std::is_same_v<From, CheckedInt>) {
+        return ScalarCast<To>(Fraction(value.Value()));
+    } else if constexpr (std::is_same_v<From, Fraction> && std::is_same_v<To, Poly>) {
+        return Poly{value};
+    } else if constexpr (std::is_same_v<From, Fraction> && std::is_same_v<To, double>) {
+        return value.ToDouble();
+    } else {
+        static_assert(std::is_same_v<To, void>, "no lossless conversion");
+    }
+}
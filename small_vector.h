@@ -0,0 +1,335 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <initializer_list>
+#include <iterator>
+#include <memory>
+#include <new>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
+
+// std::vector look-alike that keeps up to N elements in place and moves to the heap only when it grows
+// past them, so short sequences cost no allocation to build or copy. Heap storage is shared between
+// copies and copied on the first write through a non-const accessor, so copying a long one is a
+// reference count increment. Sizes are 32-bit to keep it compact.
+// The method names follow std::vector, so it can stand in for one and convert to std::span.
+template <class T, size_t N>
+class SmallVector {
+    static_assert(N > 0, "use std::vector without the in-place buffer");
+    static_assert(std::is_nothrow_move_constructible_v<T>, "moves between the buffers must not throw");
+
+public:
+    SmallVector() noexcept {
+    }
+
+    SmallVector(std::initializer_list<T> values) {
+        assign(values.begin(), values.end());
+    }
+
+    SmallVector(const SmallVector& other) {
+        Share(other);
+    }
+
+    SmallVector(SmallVector&& other) noexcept {
+        Steal(other);
+    }
+
+    SmallVector& operator=(const SmallVector& other) {
+        if (this != &other) {
+            SmallVector copy(other);
+            *this = std::move(copy);
+        }
+        return *this;
+    }
+
+    SmallVector& operator=(SmallVector&& other) noexcept {
+        if (this != &other) {
+            Drop();
+            Steal(other);
+        }
+        return *this;
+    }
+
+    ~SmallVector() {
+        Drop();
+    }
+
+    T* data() {
+        Detach();
+        return Elements();
+    }
+
+    const T* data() const {
+        return Elements();
+    }
+
+    T* begin() {
+        return data();
+    }
+
+    T* end() {
+        return data() + size_;
+    }
+
+    const T* begin() const {
+        return Elements();
+    }
+
+    const T* end() const {
+        return Elements() + size_;
+    }
+
+    std::reverse_iterator<const T*> rbegin() const {
+        return std::reverse_iterator(end());
+    }
+
+    std::reverse_iterator<const T*> rend() const {
+        return std::reverse_iterator(begin());
+    }
+
+    size_t size() const {
+        return size_;
+    }
+
+    bool empty() const {
+        return size_ == 0;
+    }
+
+    T& operator[](size_t id) {
+        return data()[id];
+    }
+
+    const T& operator[](size_t id) const {
+        return Elements()[id];
+    }
+
+    T& back() {
+        return data()[size_ - 1];
+    }
+
+    const T& back() const {
+        return Elements()[size_ - 1];
+    }
+
+    // unlike std::vector frees the heap storage too
+    void clear() {
+        Drop();
+    }
+
+    void reserve(size_t capacity) {
+        if (capacity > capacity_) {
+            Reallocate(capacity);
+        }
+    }
+
+    void resize(size_t size) {
+        if (size > capacity_) {
+            Reallocate(std::max<size_t>(size, 2 * capacity_));
+        } else {
+            Detach();
+        }
+        if (size > size_) {
+            std::uninitialized_value_construct(Elements() + size_, Elements() + size);
+        } else {
+            std::destroy(Elements() + size, Elements() + size_);
+        }
+        size_ = static_cast<uint32_t>(size);
+    }
+
+    // moves the elements in place if they fit or into storage of the exact size
+    void shrink_to_fit() {
+        if (!IsInline() && size_ < capacity_) {
+            Reallocate(std::max<size_t>(size_, N));
+        }
+    }
+
+    template <class... Args>
+    T& emplace_back(Args&&... args) {
+        if (size_ == capacity_) {
+            Reallocate(2 * capacity_);
+        } else {
+            Detach();
+        }
+        T* result = std::construct_at(Elements() + size_, std::forward<Args>(args)...);
+        ++size_;
+        return *result;
+    }
+
+    void push_back(T value) {
+        emplace_back(std::move(value));
+    }
+
+    void pop_back() {
+        Detach();
+        std::destroy_at(Elements() + size_ - 1);
+        --size_;
+    }
+
+    T* erase(T* first, T* last) {
+        T* tail = std::move(last, end(), first);
+        std::destroy(tail, end());
+        size_ = static_cast<uint32_t>(tail - Elements());
+        return first;
+    }
+
+    template <class Iterator>
+    void assign(Iterator first, Iterator last) {
+        clear();
+        auto size = static_cast<size_t>(std::distance(first, last));
+        reserve(size);
+        std::uninitialized_copy(first, last, Elements());
+        size_ = static_cast<uint32_t>(size);
+    }
+
+    // equal storage holds an equal sequence, and two distinct canonical storages never do
+    bool operator==(const SmallVector& other) const {
+        if (!IsInline() && !other.IsInline()) {
+            if (heap_ == other.heap_ && size_ == other.size_) {
+                return true;
+            }
+            if (heap_->canonical.load(std::memory_order_relaxed)
+                && other.heap_->canonical.load(std::memory_order_relaxed))
+            {
+                return false;
+            }
+        }
+        return std::equal(begin(), end(), other.begin(), other.end());
+    }
+
+    // The caller promises that no other canonical storage holds an equal sequence. The storage
+    // stays immutable from then on, owners copy it on write even when they are the only one left.
+    void MarkCanonical() const {
+        if (!IsInline()) {
+            heap_->canonical.store(true, std::memory_order_relaxed);
+        }
+    }
+
+private:
+    struct alignas(std::max(alignof(T), alignof(std::atomic<uint32_t>))) Block {
+        std::atomic<uint32_t> references = 1;
+        std::atomic<bool> canonical = false;
+
+        T* Elements() {
+            return reinterpret_cast<T*>(this + 1);
+        }
+    };
+
+    bool IsInline() const {
+        return capacity_ == N;
+    }
+
+    bool IsShared() const {
+        return !IsInline() && (heap_->references.load(std::memory_order_acquire) > 1
+                               || heap_->canonical.load(std::memory_order_relaxed));
+    }
+
+    T* Elements() {
+        return IsInline() ? reinterpret_cast<T*>(inline_) : heap_->Elements();
+    }
+
+    const T* Elements() const {
+        return IsInline() ? reinterpret_cast<const T*>(inline_) : heap_->Elements();
+    }
+
+    void Detach() {
+        if (IsShared()) {
+            Reallocate(capacity_);
+        }
+    }
+
+    // moves the elements or, out of shared storage, copies them into storage of that capacity,
+    // which is in place for N
+    void Reallocate(size_t capacity) {
+        if (capacity > UINT32_MAX) {
+            throw std::length_error("SmallVector is too long");
+        }
+        Block* old = IsInline() ? nullptr : heap_;
+        bool copy = IsShared();
+        T* from = Elements();
+        Block* block = capacity > N ? new (::operator new(sizeof(Block) + capacity * sizeof(T))) Block : nullptr;
+        T* to = block ? block->Elements() : reinterpret_cast<T*>(inline_);
+        if (copy) {
+            try {
+                std::uninitialized_copy_n(from, size_, to);
+            } catch (...) {
+                Free(block);
+                heap_ = old;
+                throw;
+            }
+            Unreference(old, size_);
+        } else {
+            std::uninitialized_move_n(from, size_, to);
+            std::destroy_n(from, size_);
+            Free(old);
+        }
+        if (block) {
+            heap_ = block;
+        }
+        capacity_ = static_cast<uint32_t>(capacity);
+    }
+
+    static void Free(Block* block) {
+        if (block) {
+            block->~Block();
+            ::operator delete(block);
+        }
+    }
+
+    // the last owner destroys the elements
+    static void Unreference(Block* block, size_t size) {
+        if (block->references.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+            std::destroy_n(block->Elements(), size);
+            Free(block);
+        }
+    }
+
+    // leaves *this empty and in place
+    void Drop() {
+        if (IsInline()) {
+            std::destroy_n(Elements(), size_);
+        } else {
+            Unreference(heap_, size_);
+        }
+        size_ = 0;
+        capacity_ = N;
+    }
+
+    // *this is empty and in place
+    void Share(const SmallVector& other) {
+        if (other.IsInline()) {
+            std::uninitialized_copy_n(other.Elements(), other.size_, Elements());
+        } else {
+            other.heap_->references.fetch_add(1, std::memory_order_relaxed);
+            heap_ = other.heap_;
+            capacity_ = other.capacity_;
+        }
+        size_ = other.size_;
+    }
+
+    // *this is empty and in place, other is left so
+    void Steal(SmallVector& other) noexcept {
+        if (other.IsInline()) {
+            std::uninitialized_move_n(other.Elements(), other.size_, Elements());
+            std::destroy_n(other.Elements(), other.size_);
+        } else {
+            heap_ = other.heap_;
+            capacity_ = other.capacity_;
+        }
+        size_ = other.size_;
+        other.size_ = 0;
+        other.capacity_ = N;
+    }
+
+private:
+    uint32_t size_ = 0;
+    // equals N while the elements are in place
+    uint32_t capacity_ = N;
+    union {
+        Block* heap_;
+        alignas(T) std::byte inline_[N * sizeof(T)];
+    };
+};
@@ -0,0 +1,277 @@
+#include "sparse_matrix.h"
+
+#include "thread_pool.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace {
+    // for approximate elements a pivot must be at least that part of the largest element in its row
+    constexpr double PIVOT_THRESHOLD = 0.1;
+    // row blocks of a sparse product per thread, every block allocates a dense accumulator
+    constexpr size_t PRODUCT_BLOCKS_PER_THREAD = 4;
+}
+
+template <Scalar T>
+SparseMatrix<T>::SparseMatrix(size_t rows, size_t columns, std::vector<size_t> row_offsets,
+                              std::vector<size_t> column_indices, std::vector<T> values)
+    : rows_(rows)
+    , columns_(columns)
+    , row_offsets_(std::move(row_offsets))
+    , column_indices_(std::move(column_indices))
+    , values_(std::move(values))
+{
+    if (row_offsets_.size() != rows_ + 1 || row_offsets_.front() != 0 || row_offsets_.back() != values_.size()
+        || column_indices_.size() != values_.size())
+    {
+        throw MatrixException("Try to create sparse matrix from inconsistent arrays");
+    }
+}
+
+template <Scalar T>
+SparseMatrix<T>::SparseMatrix(const Matrix<T>& matrix)
+    : rows_(matrix.Rows())
+    , columns_(matrix.Columns())
+{
+    for (size_t i = 0; i < rows_; ++i) {
+        auto row = matrix.Row(i);
+        for (size_t j = 0; j < columns_; ++j) {
+            if (!IsZero(row[j])) {
+                column_indices_.push_back(j);
+                values_.push_back(row[j]);
+            }
+        }
+        row_offsets_.push_back(values_.size());
+    }
+}
+
+template <Scalar T>
+size_t SparseMatrix<T>::Rows() const {
+    return rows_;
+}
+
+template <Scalar T>
+size_t SparseMatrix<T>::Columns() const {
+    return columns_;
+}
+
+template <Scalar T>
+size_t SparseMatrix<T>::NonZeros() const {
+    return values_.size();
+}
+
+template <Scalar T>
+Matrix<T> SparseMatrix<T>::ToDense() const {
+    Matrix<T> result(rows_, columns_);
+    for (size_t i = 0; i < rows_; ++i) {
+        for (size_t id = row_offsets_[i]; id < row_offsets_[i + 1]; ++id) {
+            result(i, column_indices_[id]) = values_[id];
+        }
+    }
+    return result;
+}
+
+template <Scalar T>
+T SparseMatrix<T>::Determinant() const requires (IS_FIELD<T> && !std::is_same_v<T, Poly>) {
+    if (rows_ != columns_) {
+        throw MatrixException("Try to find determinant of non square matrix");
+    }
+
+    using SparseRow = std::vector<std::pair<size_t, T>>;
+    std::vector<SparseRow> lines(rows_);
+    for (size_t i = 0; i < rows_; ++i) {
+        for (size_t id = row_offsets_[i]; id < row_offsets_[i + 1]; ++id) {
+            lines[i].emplace_back(column_indices_[id], values_[id]);
+        }
+    }
+
+    std::vector<bool> row_active(rows_, true);
+    std::vector<size_t> pivot_column(rows_);
+    std::vector<size_t> column_count(columns_);
+    T result{1};
+
+    for (size_t step = 0; step < rows_; ++step) {
+        std::fill(column_count.begin(), column_count.end(), 0);
+        for (size_t i = 0; i < rows_; ++i) {
+            if (!row_active[i]) continue;
+            for (const auto& [j, value] : lines[i]) {
+                ++column_count[j];
+            }
+        }
+
+        size_t best_row = rows_;
+        size_t best_column = columns_;
+        size_t best_cost = 0;
+        for (size_t i = 0; i < rows_; ++i) {
+            if (!row_active[i] || lines[i].empty()) continue;
+            double largest = 0;
+            if constexpr (IS_APPROXIMATE<T>) {
+                for (const auto& [j, value] : lines[i]) {
+                    largest = std::max(largest, std::abs(value));
+                }
+            }
+            for (const auto& [j, value] : lines[i]) {
+                if constexpr (IS_APPROXIMATE<T>) {
+                    if (std::abs(value) < PIVOT_THRESHOLD * largest) continue;
+                }
+                size_t cost = (lines[i].size() - 1) * (column_count[j] - 1);
+                if (best_row == rows_ || cost < best_cost) {
+                    best_row = i;
+                    best_column = j;
+                    best_cost = cost;
+                }
+            }
+        }
+        if (best_row == rows_) {
+            return T{};
+        }
+
+        const auto& pivot_line = lines[best_row];
+        T pivot = std::find_if(pivot_line.begin(), pivot_line.end(),
+            [&] (const auto& element) { return element.first == best_column; })->second;
+        result *= pivot;
+        row_active[best_row] = false;
+        pivot_column[best_row] = best_column;
+
+        ThreadPool::Instance().ParallelFor(0, rows_, [&] (size_t i) {
+            if (!row_active[i]) return;
+            auto& line = lines[i];
+            auto it = std::lower_bound(line.begin(), line.end(), best_column,
+                [] (const auto& element, size_t column) { return element.first < column; });
+            if (it == line.end() || it->first != best_column) return;
+            T factor = it->second / pivot;
+
+            SparseRow merged;
+            merged.reserve(line.size() + pivot_line.size());
+            auto lhs = line.begin();
+            auto rhs = pivot_line.begin();
+            while (lhs != line.end() || rhs != pivot_line.end()) {
+                if (rhs == pivot_line.end() || (lhs != line.end() && lhs->first < rhs->first)) {
+                    merged.push_back(std::move(*lhs++));
+                } else if (lhs == line.end() || rhs->first < lhs->first) {
+                    merged.emplace_back(rhs->first, T{});
+                    SubProduct(merged.back().second, factor, rhs->second);
+                    ++rhs;
+                } else {
+                    SubProduct(lhs->second, factor, rhs->second);
+                    if (lhs->first != best_column && !IsZero(lhs->second)) {
+                        merged.push_back(std::move(*lhs));
+                    }
+                    ++lhs;
+                    ++rhs;
+                }
+            }
+            line = std::move(merged);
+        });
+    }
+
+    // sign of the permutation row -> pivot column
+    std::vector<bool> visited(rows_, false);
+    for (size_t i = 0; i < rows_; ++i) {
+        if (visited[i]) continue;
+        size_t length = 0;
+        for (size_t j = i; !visited[j]; j = pivot_column[j]) {
+            visited[j] = true;
+            ++length;
+        }
+        if (length % 2 == 0) {
+            result = -result;
+        }
+    }
+    return result;
+}
+
+template <Scalar T>
+SparseMatrix<T>& SparseMatrix<T>::operator*=(const SparseMatrix& other) {
+    *this = *this * other;
+    return *this;
+}
+
+// Gustavson's row by row product, rows are split into blocks with a dense accumulator each
+template <Scalar T>
+SparseMatrix<T> operator*(const SparseMatrix<T>& lhs, const SparseMatrix<T>& rhs) {
+    if (lhs.columns_ != rhs.rows_) {
+        throw MatrixException("Try to multiply matrixes of wrong sizes");
+    }
+
+    std::vector<std::vector<std::pair<size_t, T>>> lines(lhs.rows_);
+    auto& pool = ThreadPool::Instance();
+    size_t blocks = std::min(lhs.rows_, pool.Size() * PRODUCT_BLOCKS_PER_THREAD);
+    size_t block_rows = blocks == 0 ? 0 : (lhs.rows_ + blocks - 1) / blocks;
+    pool.ParallelFor(0, blocks, [&] (size_t block) {
+        std::vector<Accumulator<T>> accumulator(rhs.columns_);
+        // the row that last touched the column
+        std::vector<size_t> touched_at(rhs.columns_, SIZE_MAX);
+        std::vector<size_t> touched;
+        for (size_t i = block * block_rows; i < std::min(lhs.rows_, (block + 1) * block_rows); ++i) {
+            touched.clear();
+            for (size_t lhs_id = lhs.row_offsets_[i]; lhs_id < lhs.row_offsets_[i + 1]; ++lhs_id) {
+                size_t k = lhs.column_indices_[lhs_id];
+                for (size_t rhs_id = rhs.row_offsets_[k]; rhs_id < rhs.row_offsets_[k + 1]; ++rhs_id) {
+                    size_t j = rhs.column_indices_[rhs_id];
+                    if (touched_at[j] != i) {
+                        touched_at[j] = i;
+                        touched.push_back(j);
+                        accumulator[j] = Accumulator<T>{};
+                    }
+                    AddProduct(accumulator[j], lhs.values_[lhs_id], rhs.values_[rhs_id]);
+                }
+            }
+
+            std::sort(touched.begin(), touched.end());
+            for (size_t j : touched) {
+                T value = Accumulated<T>(accumulator[j]);
+                if (!IsZero(value)) {
+                    lines[i].emplace_back(j, std::move(value));
+                }
+            }
+        }
+    });
+
+    std::vector<size_t> row_offsets = {0};
+    std::vector<size_t> column_indices;
+    std::vector<T> values;
+    for (auto& line : lines) {
+        for (auto& [j, value] : line) {
+            column_indices.push_back(j);
+            values.push_back(std::move(value));
+        }
+        row_offsets.push_back(values.size());
+    }
+    return SparseMatrix<T>(lhs.rows_, rhs.columns_, std::move(row_offsets), std::move(column_indices),
+                           std::move(values));
+}
+
+template <Scalar T>
+Matrix<T> operator*(const SparseMatrix<T>& lhs, const Matrix<T>& rhs) {
+    if (lhs.columns_ != rhs.Rows()) {
+        throw MatrixException("Try to multiply matrixes of wrong sizes");
+    }
+
+    Matrix<T> result(lhs.rows_, rhs.Columns());
+    ThreadPool::Instance().ParallelFor(0, lhs.rows_, [&] (size_t i) {
+        auto result_row = result.Row(i);
+        for (size_t id = lhs.row_offsets_[i]; id < lhs.row_offsets_[i + 1]; ++id) {
+            auto rhs_row = rhs.Row(lhs.column_indices_[id]);
+            for (size_t j = 0; j < rhs_row.size(); ++j) {
+                AddProduct(result_row[j], lhs.values_[id], rhs_row[j]);
+            }
+        }
+    });
+    return result;
+}
+
+template class SparseMatrix<CheckedInt>;
+template class SparseMatrix<Fraction>;
+template class SparseMatrix<double>;
+template class SparseMatrix<Poly>;
+
+template SparseMatrix<CheckedInt> operator*(const SparseMatrix<CheckedInt>& lhs, const SparseMatrix<CheckedInt>& rhs);
+template SparseMatrix<Fraction> operator*(const SparseMatrix<Fraction>& lhs, const SparseMatrix<Fraction>& rhs);
+template SparseMatrix<double> operator*(const SparseMatrix<double>& lhs, const SparseMatrix<double>& rhs);
+template SparseMatrix<Poly> operator*(const SparseMatrix<Poly>& lhs, const SparseMatrix<Poly>& rhs);
+
+template Matrix<CheckedInt> operator*(const SparseMatrix<CheckedInt>& lhs, const Matrix<CheckedInt>& rhs);
+template Matrix<Fraction> operator*(const SparseMatrix<Fraction>& lhs, const Matrix<Fraction>& rhs);
+template Matrix<double> operator*(const SparseMatrix<double>& lhs, const Matrix<double>& rhs);
+template Matrix<Poly> operator*(const SparseMatrix<Poly>& lhs, const Matrix<Poly>& rhs);
@@ -0,0 +1,52 @@
+#pragma once
+
+#include "matrix.h"
+
+#include <vector>
+
+// Compressed sparse row matrix: nonzero elements of row i are values_[row_offsets_[i]..row_offsets_[i + 1])
+// with their columns in column_indices_, sorted by column.
+template <Scalar T>
+class SparseMatrix {
+public:
+    SparseMatrix() = default;
+    SparseMatrix(size_t rows, size_t columns, std::vector<size_t> row_offsets, std::vector<size_t> column_indices,
+                 std::vector<T> values);
+    explicit SparseMatrix(const Matrix<T>& matrix);
+
+    SparseMatrix(const SparseMatrix& other) = default;
+    SparseMatrix(SparseMatrix&& other) = default;
+
+    SparseMatrix& operator=(const SparseMatrix& other) = default;
+    SparseMatrix& operator=(SparseMatrix&& other) = default;
+
+    size_t Rows() const;
+    size_t Columns() const;
+    size_t NonZeros() const;
+
+    Matrix<T> ToDense() const;
+
+    // Gaussian elimination with Markowitz pivot choice: the pivot with the smallest
+    // (row count - 1) * (column count - 1) is taken first, which keeps the fill-in low
+    T Determinant() const requires (IS_FIELD<T> && !std::is_same_v<T, Poly>);
+
+    SparseMatrix& operator*=(const SparseMatrix& other);
+
+    template <Scalar U>
+    friend SparseMatrix<U> operator*(const SparseMatrix<U>& lhs, const SparseMatrix<U>& rhs);
+    template <Scalar U>
+    friend Matrix<U> operator*(const SparseMatrix<U>& lhs, const Matrix<U>& rhs);
+
+private:
+    size_t rows_ = 0;
+    size_t columns_ = 0;
+    std::vector<size_t> row_offsets_ = {0};
+    std::vector<size_t> column_indices_;
+    std::vector<T> values_;
+};
+
+template <Scalar T>
+SparseMatrix<T> operator*(const SparseMatrix<T>& lhs, const SparseMatrix<T>& rhs);
+
+template <Scalar T>
+Matrix<T> operator*(const SparseMatrix<T>& lhs, const Matrix<T>& rhs);
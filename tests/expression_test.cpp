@@ -0,0 +1,50 @@
+// Compound assignments of lazy expressions that read the destination itself. Returns nonzero
+// and prints the failed cases if any.
+
+#include "matrix.h"
+
+#include <cstdio>
+
+namespace {
+    int failures = 0;
+
+    Matrix<CheckedInt> Single(int64_t value) {
+        Matrix<CheckedInt> result(1);
+        result(0, 0) = value;
+        return result;
+    }
+
+    void Expect(const char* name, const Matrix<CheckedInt>& matrix, int64_t expected) {
+        if (matrix(0, 0) != CheckedInt(expected)) {
+            std::printf("%s: got %lld, expected %lld\n", name, static_cast<long long>(matrix(0, 0).Value()),
+                        static_cast<long long>(expected));
+            ++failures;
+        }
+    }
+}
+
+int main() {
+    const auto b = Single(3);
+
+    auto a = Single(5);
+    a += b - a;
+    Expect("A += B - A", a, 3);
+
+    a = Single(5);
+    a -= b - a;
+    Expect("A -= B - A", a, 7);
+
+    a = Single(5);
+    a += a + a;
+    Expect("A += A + A", a, 15);
+
+    a = Single(5);
+    a -= -a * CheckedInt(2);
+    Expect("A -= -A * 2", a, 15);
+
+    a = Single(5);
+    a += b + b;
+    Expect("A += B + B", a, 11);
+
+    return failures == 0 ? 0 : 1;
+}
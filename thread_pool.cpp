@@ -0,0 +1,187 @@
+#include "thread_pool.h"
+
+#include <algorithm>
+#include <optional>
+
+namespace {
+    // number of chunks per thread in ParallelFor, more of them balance uneven rows better
+    constexpr size_t CHUNKS_PER_THREAD = 4;
+    constexpr size_t MIN_TASK_WORK = 256;
+
+    thread_local const void* current_pool = nullptr;
+    thread_local size_t current_queue = 0;
+
+    std::unique_ptr<ThreadPool> instance;
+    std::once_flag instance_flag;
+}
+
+ThreadPool::ThreadPool(size_t threads) {
+    threads = std::max<size_t>(threads, 1);
+    for (size_t i = 0; i + 1 < threads; ++i) {
+        queues_.push_back(std::make_unique<Queue>());
+    }
+    for (size_t i = 0; i + 1 < threads; ++i) {
+        workers_.emplace_back([this, i] { WorkerLoop(i); });
+    }
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        std::lock_guard lock(sleep_mutex_);
+        stop_ = true;
+    }
+    wake_.notify_all();
+    for (auto& worker : workers_) {
+        worker.join();
+    }
+}
+
+ThreadPool& ThreadPool::Instance() {
+    std::call_once(instance_flag, [] {
+        instance = std::make_unique<ThreadPool>(std::thread::hardware_concurrency());
+    });
+    return *instance;
+}
+
+void ThreadPool::SetThreadCount(size_t threads) {
+    bool created = false;
+    std::call_once(instance_flag, [&] {
+        instance = std::make_unique<ThreadPool>(threads);
+        created = true;
+    });
+    if (!created) {
+        instance = std::make_unique<ThreadPool>(threads);
+    }
+}
+
+size_t ThreadPool::Size() const {
+    return workers_.size() + 1;
+}
+
+size_t ThreadPool::Grain(size_t work_per_index) {
+    return std::max<size_t>(1, MIN_TASK_WORK / std::max<size_t>(work_per_index, 1));
+}
+
+void ThreadPool::ParallelFor(size_t begin, size_t end, const std::function<void(size_t)>& body, size_t grain) {
+    if (begin >= end) {
+        return;
+    }
+    size_t chunk = std::max<size_t>(grain, (end - begin + Size() * CHUNKS_PER_THREAD - 1) / (Size() * CHUNKS_PER_THREAD));
+    if (workers_.empty() || end - begin <= chunk) {
+        for (size_t i = begin; i < end; ++i) {
+            body(i);
+        }
+        return;
+    }
+
+    std::vector<std::function<void()>> tasks;
+    for (size_t from = begin; from < end; from += chunk) {
+        size_t to = std::min(from + chunk, end);
+        tasks.emplace_back([&body, from, to] {
+            for (size_t i = from; i < to; ++i) {
+                body(i);
+            }
+        });
+    }
+    Run(tasks);
+}
+
+void ThreadPool::Run(const std::vector<std::function<void()>>& tasks) {
+    if (workers_.empty()) {
+        for (const auto& task : tasks) {
+            task();
+        }
+        return;
+    }
+
+    Group group;
+    group.remaining = tasks.size();
+    for (const auto& task : tasks) {
+        Push({task, &group});
+    }
+    Wait(group);
+    if (group.exception) {
+        std::rethrow_exception(group.exception);
+    }
+}
+
+void ThreadPool::Push(Task task) {
+    size_t id = current_pool == this ? current_queue : next_queue_++ % queues_.size();
+    {
+        std::lock_guard lock(sleep_mutex_);
+        ++pending_;
+    }
+    {
+        std::lock_guard lock(queues_[id]->mutex);
+        queues_[id]->tasks.push_back(std::move(task));
+    }
+    wake_.notify_one();
+}
+
+bool ThreadPool::TryRunOne() {
+    std::optional<Task> task;
+    size_t self = current_pool == this ? current_queue : 0;
+    for (size_t shift = 0; shift < queues_.size() && !task; ++shift) {
+        auto& queue = *queues_[(self + shift) % queues_.size()];
+        std::lock_guard lock(queue.mutex);
+        if (queue.tasks.empty()) {
+            continue;
+        }
+        if (shift == 0 && current_pool == this) {
+            task = std::move(queue.tasks.back());
+            queue.tasks.pop_back();
+        } else {
+            task = std::move(queue.tasks.front());
+            queue.tasks.pop_front();
+        }
+    }
+    if (!task) {
+        return false;
+    }
+    --pending_;
+
+    try {
+        task->function();
+    } catch (...) {
+        std::lock_guard lock(task->group->mutex);
+        if (!task->group->exception) {
+            task->group->exception = std::current_exception();
+        }
+    }
+    if (--task->group->remaining == 0) {
+        // the waiter may be asleep, the lock orders this with its check, the group may be gone after it
+        { std::lock_guard lock(sleep_mutex_); }
+        wake_.notify_all();
+    }
+    return true;
+}
+
+void ThreadPool::Wait(Group& group) {
+    while (group.remaining > 0) {
+        if (TryRunOne()) {
+            continue;
+        }
+        // nothing to help with, sleep until the group is done or more tasks are queued
+        std::unique_lock lock(sleep_mutex_);
+        wake_.wait(lock, [&] { return group.remaining == 0 || pending_ > 0; });
+    }
+    // the wake for a queued task may have come here, pass it on to a worker
+    if (pending_ > 0) {
+        wake_.notify_one();
+    }
+}
+
+void ThreadPool::WorkerLoop(size_t id) {
+    current_pool = this;
+    current_queue = id;
+    while (true) {
+        if (TryRunOne()) {
+            continue;
+        }
+        std::unique_lock lock(sleep_mutex_);
+        wake_.wait(lock, [this] { return stop_ || pending_ > 0; });
+        if (stop_) {
+            return;
+        }
+    }
+}
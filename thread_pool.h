@@ -0,0 +1,68 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Work-stealing pool: every worker owns a deque, takes its own tasks from the back
+// and steals from the front of the others. A thread waiting for its tasks runs
+// queued ones meanwhile, so nested parallel calls don't deadlock, and sleeps when there are none.
+class ThreadPool {
+public:
+    explicit ThreadPool(size_t threads);
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool& other) = delete;
+    ThreadPool& operator=(const ThreadPool& other) = delete;
+
+    static ThreadPool& Instance();
+    // replaces the instance, only while no other thread uses it
+    static void SetThreadCount(size_t threads);
+
+    // counts the calling thread too
+    size_t Size() const;
+
+    // grain that gives tasks enough element operations to pay for scheduling
+    static size_t Grain(size_t work_per_index);
+
+    // every index is processed by exactly one thread, chunks contain at least grain indices
+    void ParallelFor(size_t begin, size_t end, const std::function<void(size_t)>& body, size_t grain = 1);
+    void Run(const std::vector<std::function<void()>>& tasks);
+
+private:
+    struct Group {
+        std::atomic<size_t> remaining = 0;
+        std::mutex mutex;
+        std::exception_ptr exception;
+    };
+
+    struct Task {
+        std::function<void()> function;
+        Group* group;
+    };
+
+    struct Queue {
+        std::mutex mutex;
+        std::deque<Task> tasks;
+    };
+
+    void Push(Task task);
+    bool TryRunOne();
+    void Wait(Group& group);
+    void WorkerLoop(size_t id);
+
+private:
+    std::vector<std::unique_ptr<Queue>> queues_;
+    std::vector<std::thread> workers_;
+    std::atomic<size_t> next_queue_ = 0;
+    std::atomic<size_t> pending_ = 0;
+    std::mutex sleep_mutex_;
+    std::condition_variable wake_;
+    bool stop_ = false;
+};
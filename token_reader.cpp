@@ -0,0 +1,114 @@
+#include "token_reader.h"
+
+#include <cerrno>
+#include <system_error>
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace {
+    constexpr size_t READ_CHUNK = 1 << 16;
+
+    bool IsSpace(char c) {
+        return c == ' ' || c == '\n' || c == '\t' || c == '\r' || c == '\v' || c == '\f';
+    }
+}
+
+TokenReader::TokenReader(int fd)
+    : fd_(fd)
+    , interactive_(isatty(fd))
+{
+    if (interactive_) {
+        return;
+    }
+    struct stat info;
+    if (fstat(fd_, &info) == 0 && S_ISREG(info.st_mode) && info.st_size > 0) {
+        void* mapped = mmap(nullptr, info.st_size, PROT_READ, MAP_PRIVATE, fd_, 0);
+        if (mapped != MAP_FAILED) {
+            madvise(mapped, info.st_size, MADV_SEQUENTIAL);
+            mapped_ = mapped;
+            data_ = static_cast<const char*>(mapped);
+            size_ = info.st_size;
+            return;
+        }
+    }
+
+    // pipes and anything else that can't be mapped
+    while (true) {
+        size_t old_size = buffer_.size();
+        buffer_.resize(old_size + READ_CHUNK);
+        ssize_t count = read(fd_, buffer_.data() + old_size, READ_CHUNK);
+        if (count < 0 && errno == EINTR) {
+            buffer_.resize(old_size);
+            continue;
+        }
+        if (count < 0) {
+            throw std::system_error(errno, std::generic_category(), "can't read input");
+        }
+        buffer_.resize(old_size + count);
+        if (count == 0) {
+            break;
+        }
+    }
+    data_ = buffer_.data();
+    size_ = buffer_.size();
+}
+
+TokenReader::~TokenReader() {
+    if (mapped_) {
+        munmap(mapped_, size_);
+    }
+}
+
+bool TokenReader::IsInteractive() const {
+    return interactive_;
+}
+
+bool TokenReader::AtEnd() {
+    while (true) {
+        while (position_ < size_ && IsSpace(data_[position_])) {
+            ++position_;
+        }
+        if (position_ < size_) {
+            return false;
+        }
+        if (!interactive_ || !ReadLine()) {
+            return true;
+        }
+    }
+}
+
+std::string_view TokenReader::Next() {
+    if (AtEnd()) {
+        return {};
+    }
+    size_t begin = position_;
+    while (position_ < size_ && !IsSpace(data_[position_])) {
+        ++position_;
+    }
+    return {data_ + begin, position_ - begin};
+}
+
+bool TokenReader::ReadLine() {
+    std::string line;
+    char c;
+    ssize_t count;
+    while ((count = read(fd_, &c, 1)) > 0 || (count < 0 && errno == EINTR)) {
+        if (count < 0) {
+            continue;
+        }
+        line += c;
+        if (c == '\n') {
+            break;
+        }
+    }
+    if (line.empty()) {
+        return false;
+    }
+    lines_.push_back(std::move(line));
+    data_ = lines_.back().data();
+    size_ = lines_.back().size();
+    position_ = 0;
+    return true;
+}
@@ -0,0 +1,38 @@
+#pragma once
+
+#include <deque>
+#include <string>
+#include <string_view>
+
+// Whitespace separated tokens of a file descriptor, every token is a view that lives as long as
+// the reader. Regular files are mapped into memory and pipes are read in one go. A terminal is
+// read line by line, so that the user can answer prompts.
+class TokenReader {
+public:
+    explicit TokenReader(int fd);
+    ~TokenReader();
+
+    TokenReader(const TokenReader& other) = delete;
+    TokenReader& operator=(const TokenReader& other) = delete;
+
+    bool IsInteractive() const;
+
+    // skips whitespace, true if no tokens are left
+    bool AtEnd();
+    // empty at the end of the input
+    std::string_view Next();
+
+private:
+    bool ReadLine();
+
+private:
+    int fd_;
+    bool interactive_ = false;
+    const char* data_ = nullptr;
+    size_t size_ = 0;
+    size_t position_ = 0;
+    void* mapped_ = nullptr;
+    std::string buffer_;
+    // lines of a terminal, a deque doesn't move them, so older tokens stay valid
+    std::deque<std::string> lines_;
+};